@@ -0,0 +1,55 @@
+#include "ActiveTiles.h"
+
+#include <algorithm>
+
+void ActiveTiles::Resize(size_t columns, size_t rows)
+{
+    columns_ = columns;
+    rows_ = rows;
+    changed_.assign(Count(), 1);
+    nextChanged_.assign(Count(), 0);
+    scheduled_.assign(Count(), 0);
+}
+
+void ActiveTiles::MarkAllChanged()
+{
+    std::fill(changed_.begin(), changed_.end(), 1);
+}
+
+const std::vector<size_t>& ActiveTiles::Schedule(size_t reach)
+{
+    schedule_.clear();
+    std::fill(scheduled_.begin(), scheduled_.end(), 0);
+
+    // Reaching across the whole torus in either direction is the same as reaching all of it
+    size_t reachX = std::min(reach, columns_ / 2);
+    size_t reachY = std::min(reach, rows_ / 2);
+
+    for (size_t tile = 0; tile < Count(); ++tile) {
+        if (!changed_[tile]) {
+            continue;
+        }
+        size_t column = tile % columns_;
+        size_t row = tile / columns_;
+        for (size_t y = row + rows_ - reachY; y <= row + rows_ + reachY; ++y) {
+            for (size_t x = column + columns_ - reachX; x <= column + columns_ + reachX; ++x) {
+                size_t neighbour = ((y % rows_) * columns_) + (x % columns_);
+                if (!scheduled_[neighbour]) {
+                    scheduled_[neighbour] = 1;
+                    schedule_.push_back(neighbour);
+                }
+            }
+        }
+    }
+
+    // Sorted so neighbouring tiles are handed to the same thread
+    std::sort(schedule_.begin(), schedule_.end());
+    processedCount_ = schedule_.size();
+    return schedule_;
+}
+
+void ActiveTiles::Finish()
+{
+    std::swap(changed_, nextChanged_);
+    std::fill(nextChanged_.begin(), nextChanged_.end(), 0);
+}
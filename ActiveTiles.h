@@ -0,0 +1,65 @@
+#ifndef ACTIVETILES_H
+#define ACTIVETILES_H
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Tracks which tiles of a torus changed in the last generation, so that a
+ * step can skip any tile with no change within reach of it.
+ *
+ * Skipping relies on the grid being double buffered: a tile that is skipped
+ * didn't change last generation, so the stale copy of it left in the buffer
+ * being written to is already the correct value for the next generation.
+ */
+class ActiveTiles {
+public:
+    /**
+     * Dimensions are in tiles, every tile starts out as changed.
+     */
+    void Resize(size_t columns, size_t rows);
+    size_t Columns() const { return columns_; }
+    size_t Rows() const { return rows_; }
+    size_t Count() const { return columns_ * rows_; }
+
+    /**
+     * Forces every tile to be processed next generation, needed whenever the
+     * cells or the rule are changed from outside of a step.
+     */
+    void MarkAllChanged();
+
+    /**
+     * Lists the tiles that need processing this generation, i.e. those within
+     * reach tiles of one that changed last generation, wrapping at the edges.
+     */
+    const std::vector<size_t>& Schedule(size_t reach);
+    /**
+     * Safe to call concurrently for different tiles.
+     */
+    void SetChanged(size_t tile) { nextChanged_[tile] = 1; }
+    /**
+     * Call once every scheduled tile has been processed.
+     */
+    void Finish();
+
+    size_t ProcessedCount() const { return processedCount_; }
+    /**
+     * Whether the tile changed in the last generation, or has been marked as
+     * changed since.
+     */
+    bool Changed(size_t tile) const { return changed_[tile]; }
+
+private:
+    size_t columns_ = 0;
+    size_t rows_ = 0;
+    size_t processedCount_ = 0;
+
+    // Bytes rather than vector<bool> so threads can write neighbouring flags
+    std::vector<uint8_t> changed_;
+    std::vector<uint8_t> nextChanged_;
+    std::vector<uint8_t> scheduled_;
+    std::vector<size_t> schedule_;
+};
+
+#endif // ACTIVETILES_H
@@ -0,0 +1,507 @@
+#include "Automaton.h"
+
+#include "Neighbourhood.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+
+Automaton::Automaton(size_t width, size_t height)
+{
+    SetCellRule(LifeRule::Conway());
+    std::get<LifeEngine>(engine_).Resize(width, height);
+}
+
+void Automaton::Step(ThreadPool& threads)
+{
+    PROFILE_SCOPE("Step");
+    if (PlaneInUse()) {
+        RefreshPlane();
+        plane_.Step(threads);
+        RefreshWindow(true);
+    } else {
+        std::visit([&](auto& engine) { engine.Step(threads); }, engine_);
+        planeStale_ = true;
+        MarkEngineChanges();
+    }
+    cellsStale_ = true;
+    ++generation_;
+    cycles_.Add(generation_, Hash());
+}
+
+// Only StencilEngine steps several generations at once
+template <typename Engine>
+struct StepsBlocks : std::false_type {};
+template <typename CellType>
+struct StepsBlocks<StencilEngine<CellType>> : std::true_type {};
+
+void Automaton::Advance(uint64_t generations, ThreadPool& threads)
+{
+    while (generations > 0) {
+        unsigned block = static_cast<unsigned>(std::min<uint64_t>(generations, BlockGenerations()));
+        if (block == 1) {
+            Step(threads);
+        } else {
+            PROFILE_SCOPE("Step block");
+            std::visit([&](auto& engine)
+            {
+                if constexpr (StepsBlocks<std::decay_t<decltype(engine)>>::value) {
+                    engine.StepBlock(block, threads);
+                    for (uint64_t hash : engine.BlockHashes()) {
+                        cycles_.Add(++generation_, hash);
+                    }
+                }
+            }, engine_);
+            planeStale_ = true;
+            cellsStale_ = true;
+            MarkEngineChanges();
+        }
+        generations -= block;
+    }
+}
+
+unsigned Automaton::BlockGenerations() const
+{
+    return std::visit([](const auto& engine) -> unsigned
+    {
+        if constexpr (StepsBlocks<std::decay_t<decltype(engine)>>::value) {
+            return engine.BlockGenerations();
+        } else {
+            return 1;
+        }
+    }, engine_);
+}
+
+static bool IsPowerOfTwo(size_t size)
+{
+    return size != 0 && (size & (size - 1)) == 0;
+}
+
+void Automaton::FastForward(unsigned log2Generations, ThreadPool& threads)
+{
+    if (!JumpWithHashLife(log2Generations)) {
+        StepTo(generation_ + (uint64_t(1) << log2Generations), threads);
+    }
+}
+
+bool Automaton::JumpWithHashLife(unsigned log2Generations)
+{
+    if (!BeginHashLifeJump(log2Generations, hashLife_) || !hashLife_.Advance(log2Generations)) {
+        // Too chaotic to fit in the node limit, nothing has changed
+        return false;
+    }
+    EndHashLifeJump(log2Generations, hashLife_);
+    return true;
+}
+
+bool Automaton::BeginHashLifeJump(unsigned log2Generations, HashLife& hashLife) const
+{
+    // HashLife treats the grid as a torus too, the plane is stepped chunk by chunk instead
+    const LifeEngine* life = std::get_if<LifeEngine>(&engine_);
+    uint64_t generations = uint64_t(1) << log2Generations;
+    // Copies of a torus whose sides aren't powers of two never line up with the quadtree, so share no nodes
+    bool pays = life && !PlaneInUse() && IsPowerOfTwo(Width()) && IsPowerOfTwo(Height())
+                && generations / HashLifeMinimumJump >= std::max(Width(), Height()) && Period() == 0;
+    if (!pays) {
+        return false;
+    }
+
+    // Straight from the bits, this is the part that can't run without the automaton
+    hashLife.SetRule(life->GetRule());
+    hashLife.Resize(Width(), Height());
+    for (size_t y = 0; y < Height(); ++y) {
+        hashLife.ImportBits(y, static_cast<const uint64_t*>(life->RowData(y)));
+    }
+    return true;
+}
+
+void Automaton::EndHashLifeJump(unsigned log2Generations, const HashLife& hashLife)
+{
+    LifeEngine& life = std::get<LifeEngine>(engine_);
+    for (size_t y = 0; y < Height(); ++y) {
+        hashLife.ExportBits(y, static_cast<uint64_t*>(life.RowData(y)));
+    }
+    life.MarkAllChanged();
+    cellsStale_ = true;
+    planeStale_ = true;
+    MarkAllChanged();
+    generation_ += uint64_t(1) << log2Generations;
+    cycles_.Reset();
+}
+
+void Automaton::StepTo(uint64_t generation, ThreadPool& threads)
+{
+    while (generation_ < generation) {
+        if (uint64_t period = Period()) {
+            // Whole periods bring the cells back to where they are now
+            uint64_t leftOver = (generation - generation_) % period;
+            uint64_t skipped = (generation - generation_) - leftOver;
+            generation_ += skipped;
+            cycles_.Reset();
+            for (uint64_t step = 0; step < leftOver; ++step) {
+                Step(threads);
+            }
+            return;
+        }
+        Step(threads);
+    }
+}
+
+uint64_t Automaton::Hash() const
+{
+    if (PlaneInUse()) {
+        return plane_.Hash();
+    }
+    return std::visit([](const auto& engine) { return engine.Hash(); }, engine_);
+}
+
+size_t Automaton::TilesProcessed() const
+{
+    if (PlaneInUse()) {
+        return plane_.ChunksProcessed();
+    }
+    return std::visit([](const auto& engine) { return engine.TilesProcessed(); }, engine_);
+}
+
+size_t Automaton::TileCount() const
+{
+    if (PlaneInUse()) {
+        return plane_.ChunkCount();
+    }
+    return std::visit([](const auto& engine) { return engine.TileCount(); }, engine_);
+}
+
+bool Automaton::BeginChanges()
+{
+    ++version_;
+    size_t columns = (Width() + ChangeTileSize - 1) / ChangeTileSize;
+    size_t rows = (Height() + ChangeTileSize - 1) / ChangeTileSize;
+    if (tileVersions_.size() != columns * rows) {
+        tileVersions_.assign(columns * rows, 0);
+        allChangedVersion_ = version_;
+        return false;
+    }
+    return true;
+}
+
+void Automaton::MarkChanged(const Tile& cells)
+{
+    if (cells.firstX >= cells.lastX || cells.firstY >= cells.lastY) {
+        return;
+    }
+    size_t columns = (Width() + ChangeTileSize - 1) / ChangeTileSize;
+    for (size_t row = cells.firstY / ChangeTileSize; row <= (cells.lastY - 1) / ChangeTileSize; ++row) {
+        for (size_t column = cells.firstX / ChangeTileSize; column <= (cells.lastX - 1) / ChangeTileSize; ++column) {
+            tileVersions_[(row * columns) + column] = version_;
+        }
+    }
+}
+
+void Automaton::MarkEngineChanges()
+{
+    if (BeginChanges()) {
+        std::visit([&](const auto& engine) { engine.ForEachChangedTile([&](const Tile& cells) { MarkChanged(cells); }); }, engine_);
+    }
+}
+
+size_t Automaton::Width() const
+{
+    return std::visit([](const auto& engine) { return engine.Width(); }, engine_);
+}
+
+size_t Automaton::Height() const
+{
+    return std::visit([](const auto& engine) { return engine.Height(); }, engine_);
+}
+
+const Grid<double>& Automaton::Cells()
+{
+    // Nothing to convert
+    if (const StencilEngine<double>* doubles = std::get_if<StencilEngine<double>>(&engine_)) {
+        return doubles->Cells();
+    }
+    if (const LeniaEngine* lenia = std::get_if<LeniaEngine>(&engine_)) {
+        return lenia->Cells();
+    }
+
+    if (cellsStale_) {
+        cells_.Resize(Width(), Height());
+        std::visit([&](const auto& engine) { engine.Export(cells_); }, engine_);
+        cellsStale_ = false;
+    }
+    return cells_;
+}
+
+double Automaton::GetCellValue(size_t x, size_t y, int offsetX, int offsetY) const
+{
+    if (PlaneInUse() && !planeStale_) {
+        return plane_.Get(static_cast<int64_t>(x) + offsetX, static_cast<int64_t>(y) + offsetY) ? 1.0 : 0.0;
+    }
+    size_t wrappedX = (x + Width() + offsetX) % Width();
+    size_t wrappedY = (y + Height() + offsetY) % Height();
+    return std::visit([&](const auto& engine) { return static_cast<double>(engine.Get(wrappedX, wrappedY)); }, engine_);
+}
+
+void Automaton::Clear(double value)
+{
+    Grid<double> cells(Width(), Height());
+    cells.Fill(value);
+    SetCells(cells);
+}
+
+void Automaton::SetDimensions(size_t width, size_t height)
+{
+    if (PlaneInUse()) {
+        RefreshPlane();
+        std::get<LifeEngine>(engine_).Resize(width, height);
+        RefreshWindow(false);
+        cellsStale_ = true;
+        MarkAllChanged();
+        return;
+    }
+
+    // The same pattern, just cropped or padded
+    uint64_t generation = generation_;
+    Grid<double> cells(Width(), Height());
+    std::visit([&](const auto& engine) { engine.Export(cells); }, engine_);
+    cells.Resize(width, height);
+    SetCells(cells);
+    generation_ = generation;
+}
+
+void Automaton::SetCells(const Grid<double>& cells)
+{
+    std::visit([&](auto& engine) { engine.Import(cells); }, engine_);
+    cellsStale_ = true;
+    planeStale_ = true;
+    MarkAllChanged();
+    generation_ = 0;
+    cycles_.Reset();
+}
+
+void Automaton::SetUnbounded(bool unbounded)
+{
+    if (unbounded == unbounded_) {
+        return;
+    }
+    if (PlaneInUse()) {
+        // The window was kept up to date, but not which of its tiles changed
+        std::get<LifeEngine>(engine_).MarkAllChanged();
+    }
+    unbounded_ = unbounded;
+    planeStale_ = true;
+    cycles_.Reset();
+}
+
+static Automaton::CellFormat FormatOf(const LifeEngine&)
+{
+    return Automaton::CellFormat::Bits;
+}
+
+static Automaton::CellFormat FormatOf(const LeniaEngine&)
+{
+    return Automaton::CellFormat::Double;
+}
+
+template <typename CellType>
+static Automaton::CellFormat FormatOf(const StencilEngine<CellType>&)
+{
+    if constexpr (std::is_same_v<CellType, uint8_t>) {
+        return Automaton::CellFormat::UInt8;
+    } else if constexpr (std::is_same_v<CellType, float>) {
+        return Automaton::CellFormat::Float;
+    } else {
+        static_assert(std::is_same_v<CellType, double>, "Every engine's cell type needs a CellFormat.");
+        return Automaton::CellFormat::Double;
+    }
+}
+
+Automaton::CellFormat Automaton::Format() const
+{
+    return std::visit([](const auto& engine) { return FormatOf(engine); }, engine_);
+}
+
+size_t Automaton::RowBytes() const
+{
+    return std::visit([](const auto& engine) { return engine.RowBytes(); }, engine_);
+}
+
+const void* Automaton::RowData(size_t y) const
+{
+    return std::visit([&](const auto& engine) { return engine.RowData(y); }, engine_);
+}
+
+void* Automaton::RowData(size_t y)
+{
+    cellsStale_ = true;
+    planeStale_ = true;
+    MarkAllChanged();
+    cycles_.Reset();
+    return std::visit([&](auto& engine) { return engine.RowData(y); }, engine_);
+}
+
+void Automaton::Reset(size_t width, size_t height)
+{
+    std::visit([&](auto& engine) { engine.Resize(width, height); }, engine_);
+    cellsStale_ = true;
+    planeStale_ = true;
+    MarkAllChanged();
+    generation_ = 0;
+    cycles_.Reset();
+}
+
+void Automaton::ImportRow(size_t y, const double* values)
+{
+    std::visit([&](auto& engine) { engine.ImportRow(y, values); }, engine_);
+    cellsStale_ = true;
+    planeStale_ = true;
+    MarkAllChanged();
+    cycles_.Reset();
+}
+
+void Automaton::ExportRow(size_t y, double* values) const
+{
+    std::visit([&](const auto& engine) { engine.ExportRow(y, values); }, engine_);
+}
+
+std::function<double (const std::function<const double& (int, int)>& getCellValue)> Automaton::GetDefaultCellStepper()
+{
+    // Conways game of life
+    return [](const GetNeighbourFunc& getCellValue) -> double
+    {
+        static auto neighbourhood = Neighbourhood::CreateNeighbourhoodCoordinates(
+                                    {
+                                        { 1, 1, 1 },
+                                        { 1, 0, 1 },
+                                        { 1, 1, 1 },
+                                    });
+        double neighbours = 0.0;
+        for (auto coord : neighbourhood) {
+            neighbours += getCellValue(coord.first, coord.second);
+        }
+
+        if (neighbours == 3 || (getCellValue(0, 0) != 0.0 && neighbours == 2.0)) {
+            return 1.0;
+        } else {
+            return 0.0;
+        }
+    };
+}
+
+void Automaton::SetCellStepper(std::function<double(const GetNeighbourFunc&)>&& stepper, unsigned radius)
+{
+    UseEngine<StencilEngine<double>>().SetTileStepper([stepper = std::move(stepper)](const Grid<double>& cells, Grid<double>& nextCells, const Tile& tile)
+    {
+        ptrdiff_t stride = cells.Stride();
+        for (size_t y = tile.firstY; y < tile.lastY; y++) {
+            const double* row = cells.Row(y);
+            double* nextRow = nextCells.Row(y);
+            for (size_t x = tile.firstX; x < tile.lastX; x++) {
+                const double* cell = row + x;
+                GetNeighbourFunc getNeighbourFunc = [=](int offsetX, int offsetY) -> const double& { return cell[(offsetY * stride) + offsetX]; };
+                nextRow[x] = stepper(getNeighbourFunc);
+            }
+        }
+    }, radius);
+    cycles_.Reset();
+}
+
+void Automaton::SetCellRule(LifeRule rule)
+{
+    bool planeWasInUse = PlaneInUse();
+    UseEngine<LifeEngine>().SetRule(rule);
+    plane_.SetRule(rule);
+    if (!planeWasInUse) {
+        planeStale_ = true;
+    }
+    cycles_.Reset();
+}
+
+void Automaton::SetCellRule(TableRule rule)
+{
+    if (std::optional<LifeRule> lifeRule = rule.AsLifeRule()) {
+        SetCellRule(*lifeRule);
+        return;
+    }
+
+    unsigned radius = rule.radius;
+    UseEngine<StencilEngine<uint8_t>>().SetTileStepper([rule = std::move(rule)](const Grid<uint8_t>& cells, Grid<uint8_t>& nextCells, const Tile& tile)
+    {
+        rule.StepTile(cells, nextCells, tile);
+    }, radius);
+    cycles_.Reset();
+}
+
+void Automaton::SetCellRule(LeniaRule rule)
+{
+    UseEngine<LeniaEngine>().SetRule(std::move(rule));
+    cycles_.Reset();
+}
+
+bool Automaton::PlaneInUse() const
+{
+    // B0 would bring every empty chunk of the plane to life at once
+    const LifeEngine* life = std::get_if<LifeEngine>(&engine_);
+    return unbounded_ && life && (life->GetRule().birth & 1) == 0;
+}
+
+// The bits of a LifeEngine row's last word that are cells, the rest may hold a guard
+static uint64_t LastWordMask(size_t width)
+{
+    size_t bitsInLastWord = width % 64;
+    return bitsInLastWord != 0 ? (uint64_t(1) << bitsInLastWord) - 1 : ~uint64_t(0);
+}
+
+void Automaton::RefreshPlane()
+{
+    if (!planeStale_) {
+        return;
+    }
+    PROFILE_SCOPE("Refresh plane");
+
+    const LifeEngine& window = std::get<LifeEngine>(engine_);
+    size_t words = (Width() + 63) / 64;
+    plane_.Clear();
+    for (size_t y = 0; y < Height(); ++y) {
+        const uint64_t* row = static_cast<const uint64_t*>(window.RowData(y));
+        for (size_t i = 0; i < words; ++i) {
+            plane_.SetWord(static_cast<int64_t>(i), static_cast<int64_t>(y), i + 1 == words ? row[i] & LastWordMask(Width()) : row[i]);
+        }
+    }
+    planeStale_ = false;
+}
+
+void Automaton::RefreshWindow(bool changedOnly)
+{
+    PROFILE_SCOPE("Refresh window");
+    LifeEngine& window = std::get<LifeEngine>(engine_);
+    int64_t words = static_cast<int64_t>((Width() + 63) / 64);
+    int64_t height = static_cast<int64_t>(Height());
+    uint64_t lastWordMask = LastWordMask(Width());
+
+    if (!changedOnly || !BeginChanges()) {
+        MarkAllChanged();
+        for (int64_t y = 0; y < height; ++y) {
+            uint64_t* row = static_cast<uint64_t*>(window.RowData(static_cast<size_t>(y)));
+            for (int64_t i = 0; i < words; ++i) {
+                row[i] = plane_.GetWord(i, y) & (i + 1 == words ? lastWordMask : ~uint64_t(0));
+            }
+        }
+        return;
+    }
+
+    // Only the chunks that changed, chunks that were freed were already empty
+    plane_.ForEachChangedChunk([&](int64_t wordX, int64_t firstY, const uint64_t* rows)
+    {
+        if (wordX < 0 || wordX >= words) {
+            return;
+        }
+        for (int64_t y = std::max<int64_t>(firstY, 0); y < std::min(firstY + LifePlane::ChunkSize, height); ++y) {
+            uint64_t* row = static_cast<uint64_t*>(window.RowData(static_cast<size_t>(y)));
+            row[wordX] = rows[y - firstY] & (wordX + 1 == words ? lastWordMask : ~uint64_t(0));
+        }
+        size_t firstX = static_cast<size_t>(wordX) * 64;
+        MarkChanged(Tile{ firstX, std::min(firstX + 64, Width()), static_cast<size_t>(std::max<int64_t>(firstY, 0)), static_cast<size_t>(std::clamp<int64_t>(firstY + LifePlane::ChunkSize, 0, height)) });
+    });
+}
@@ -0,0 +1,311 @@
+#ifndef AUTOMATON_H
+#define AUTOMATON_H
+
+#include "Philox.h"
+#include "ThreadPool.h"
+#include "Grid.h"
+#include "Stencil.h"
+#include "StencilEngine.h"
+#include "LifeRule.h"
+#include "TableRule.h"
+#include "LifeEngine.h"
+#include "LeniaEngine.h"
+#include "LifePlane.h"
+#include "HashLife.h"
+#include "CycleDetector.h"
+
+#include <algorithm>
+#include <functional>
+#include <variant>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * The cells of a toroidal automaton and the rule that steps them, without any
+ * GUI. Depending on the rule the cells are stepped by a per rule stencil
+ * kernel, bit-packed by LifeEngine, or by FFT convolution in LeniaEngine, see
+ * SetCellRule.
+ *
+ * Life-like rules can instead be stepped on an unbounded plane, see
+ * SetUnbounded, in which case the grid is a window onto it.
+ *
+ * Cells are read and written as doubles, but are only stored as whatever the
+ * current rule needs, e.g. one byte a cell for discrete states. A grid of
+ * doubles is only kept alongside once Cells() has been asked for.
+ *
+ * Not thread safe, though every step is spread across the ThreadPool given.
+ */
+class Automaton {
+public:
+    using GetNeighbourFunc = std::function<const double& (int xOffset, int yOffset)>;
+
+    /**
+     * How the engine in use stores its cells, see RowData.
+     */
+    enum class CellFormat : uint32_t {
+        // A bit per cell, in 64 bit words, LifeEngine
+        Bits = 0,
+        UInt8 = 1,
+        Float = 2,
+        Double = 3,
+    };
+
+    Automaton(size_t width = 100, size_t height = 100);
+
+    void Step(ThreadPool& threads);
+    /**
+     * Steps generations on, BlockGenerations() at a time, with the same result
+     * as calling Step() that many times. Every generation is still checked
+     * for a cycle.
+     */
+    void Advance(uint64_t generations, ThreadPool& threads);
+    /**
+     * How many generations the engine in use can step at once while they are
+     * in cache, see StencilEngine::StepBlock. 1 for LifeEngine, whose cells
+     * are packed a bit each and so are far less bound by memory, and for
+     * LeniaEngine, whose every generation needs the whole grid at once.
+     */
+    unsigned BlockGenerations() const;
+    /**
+     * Advances 2^log2Generations generations, with JumpWithHashLife if it
+     * can, otherwise by stepping there, see StepTo.
+     */
+    void FastForward(unsigned log2Generations, ThreadPool& threads);
+    /**
+     * Jumps LifeRules on a torus whose sides are powers of two straight on by
+     * 2^log2Generations generations with HashLife, when the jump is at least
+     * HashLifeMinimumJump times the longest side and the cells haven't
+     * already settled into a cycle. Anywhere else stepping is faster, as it
+     * is for patterns too chaotic for HashLife's node limit. False, with
+     * nothing changed, if it didn't.
+     */
+    bool JumpWithHashLife(unsigned log2Generations);
+    static constexpr uint64_t HashLifeMinimumJump = 64;
+    /**
+     * JumpWithHashLife in parts, so that hashLife can Advance without the
+     * automaton, e.g. without holding a lock on it. False, leaving hashLife
+     * alone, if JumpWithHashLife wouldn't try, otherwise hashLife is given the
+     * rule and cells. End takes the cells back once hashLife has advanced
+     * them, and the automaton mustn't have changed in between.
+     */
+    bool BeginHashLifeJump(unsigned log2Generations, HashLife& hashLife) const;
+    void EndHashLifeJump(unsigned log2Generations, const HashLife& hashLife);
+    /**
+     * Steps on to generation, though once the cells have settled into a cycle
+     * only the generations left over from whole periods are stepped, and the
+     * rest are skipped.
+     */
+    void StepTo(uint64_t generation, ThreadPool& threads);
+
+    /**
+     * Counts every generation stepped, and restarts from zero whenever the
+     * cells are replaced, randomised or cleared.
+     */
+    uint64_t Generation() const { return generation_; }
+    void SetGeneration(uint64_t generation) { generation_ = generation; cycles_.Reset(); }
+
+    /**
+     * A CellHash of the cells, kept up to date by each step from only the
+     * cells it changed, so equal hashes can be taken to be equal cells. Only
+     * up to date once stepped since the cells were last written to, and only
+     * comparable while the rule stores its cells the same way.
+     */
+    uint64_t Hash() const;
+    /**
+     * The period of the cycle the cells have settled into, 1 for a still
+     * life, or 0 if they haven't settled, see CycleDetector.
+     */
+    uint64_t Period() const { return cycles_.Period(); }
+
+    /**
+     * Tiles are only recomputed when something within reach of them changed
+     * in the previous generation, this is how many were in the last Step().
+     * While the plane is unbounded these count its chunks instead.
+     */
+    size_t TilesProcessed() const;
+    size_t TileCount() const;
+
+    /**
+     * For keeping a copy of the cells up to date a tile at a time without
+     * comparing them, see CellPyramid. Version() counts changes to the cells,
+     * and TileVersion() is the version at which a ChangeTileSize square tile
+     * of cells, numbered row by row, last changed. A copy made at one version
+     * only needs the tiles whose version is later.
+     */
+    static constexpr size_t ChangeTileSize = 64;
+    uint64_t Version() const { return version_; }
+    uint64_t TileVersion(size_t tile) const { return std::max(allChangedVersion_, tile < tileVersions_.size() ? tileVersions_[tile] : 0); }
+
+    size_t Width() const;
+    size_t Height() const;
+
+    /**
+     * The current generation, converted to doubles if the rule stores its
+     * cells as something else.
+     */
+    const Grid<double>& Cells();
+
+    /**
+     * Offsets wrap around the edges, unless the plane is unbounded.
+     */
+    double GetCellValue(size_t x, size_t y, int offsetX = 0, int offsetY = 0) const;
+
+    void Clear(double value = 0.0);
+    /**
+     * Crops or pads the cells, or while the plane is unbounded resizes the
+     * window onto it without losing anything.
+     */
+    void SetDimensions(size_t width, size_t height);
+    /**
+     * While unbounded, Life-like rules (other than those with B0) step the
+     * cells on an infinite plane, see LifePlane, rather than on a torus.
+     * Everything else, e.g. Cells() and RowData, sees the window of the plane
+     * from (0, 0) to (Width(), Height()), and only stepping keeps the cells
+     * outside of it. Other rules carry on wrapping around the window.
+     */
+    void SetUnbounded(bool unbounded);
+    bool Unbounded() const { return unbounded_; }
+    /**
+     * Each cell's value depends only on the seed and its position, so the same
+     * seed fills the same grid whatever the thread count.
+     */
+    template <typename T>
+    void Randomise(T min, T max, uint64_t seed, ThreadPool& threads)
+    {
+        std::visit([&](auto& engine) { engine.Randomise(min, max, seed, threads); }, engine_);
+        cellsStale_ = true;
+        planeStale_ = true;
+        MarkAllChanged();
+        generation_ = 0;
+        cycles_.Reset();
+    }
+    /**
+     * Replaces the cells, and the dimensions, with those given.
+     */
+    void SetCells(const Grid<double>& cells);
+
+    /**
+     * The cells exactly as the current engine stores them, RowBytes() bytes a
+     * row, for saving and restoring them without converting each cell, see
+     * Checkpoint. Rows are only written straight after Reset(), as writing
+     * one doesn't mark anything as changed. Getting a row to write does, so
+     * the rows are got on one thread before writing them on several.
+     */
+    CellFormat Format() const;
+    size_t RowBytes() const;
+    const void* RowData(size_t y) const;
+    void* RowData(size_t y);
+    /**
+     * Resizes without keeping anything, every cell is zero.
+     */
+    void Reset(size_t width, size_t height);
+    /**
+     * Width() values at a time, converted as SetCells and Cells() would, but
+     * without a whole grid of doubles. Like RowData, importing a row is only
+     * for filling in the cells straight after Reset().
+     */
+    void ImportRow(size_t y, const double* values);
+    void ExportRow(size_t y, double* values) const;
+
+    static std::function<double (const GetNeighbourFunc& getCellValue)> GetDefaultCellStepper();
+
+    /**
+     * Slow path for ad-hoc rules, every neighbour read goes through two
+     * std::functions. The radius is the furthest offset, horizontally or
+     * vertically, that the stepper will ask getCellValue for.
+     */
+    void SetCellStepper(std::function<double(const GetNeighbourFunc& getCellValue)>&& stepper, unsigned radius = 1);
+    /**
+     * Instantiates the step kernel for this rule, see Stencil::Step and
+     * Rules.h. Only one indirect call is made per tile, rather than per read.
+     * The cells are converted to the rule's CellType.
+     */
+    template <typename Rule>
+    void SetCellRule(Rule rule)
+    {
+        using CellType = typename Stencil::CellTypeOf<Rule>::type;
+        UseEngine<StencilEngine<CellType>>().SetTileStepper([rule = std::move(rule)](const Grid<CellType>& cells, Grid<CellType>& nextCells, const Tile& tile)
+        {
+            Stencil::Step(rule, cells, nextCells, tile);
+        }, Rule::Radius);
+        cycles_.Reset();
+    }
+    /**
+     * Binary Life-like rules are stepped bit-packed by LifeEngine instead.
+     */
+    void SetCellRule(LifeRule rule);
+    /**
+     * Rules compiled from notation, also handed to LifeEngine when they turn
+     * out to be Life-like.
+     */
+    void SetCellRule(TableRule rule);
+    /**
+     * Continuous rules with a wide kernel, stepped by LeniaEngine.
+     */
+    void SetCellRule(LeniaRule rule);
+
+private:
+    // Whichever is in use holds the real state of the cells
+    std::variant<LifeEngine, StencilEngine<uint8_t>, StencilEngine<float>, StencilEngine<double>, LeniaEngine> engine_;
+    // The cells as doubles for Cells(), out of date whenever cellsStale_ is set
+    Grid<double> cells_;
+    bool cellsStale_ = true;
+    uint64_t generation_ = 0;
+    // Fed every step's hash, and reset whenever the cells or rule change otherwise
+    CycleDetector cycles_;
+    // Kept between jumps, so that its cache can be reused
+    HashLife hashLife_;
+    // Holds the real cells while PlaneInUse(), the LifeEngine is kept up to date as the window onto it
+    LifePlane plane_;
+    bool unbounded_ = false;
+    // Set whenever the window is written to other than from the plane, which is then refilled from it before stepping
+    bool planeStale_ = true;
+    uint64_t version_ = 0;
+    // Every tile changed at this version, e.g. when the cells were replaced
+    uint64_t allChangedVersion_ = 0;
+    // Of each ChangeTileSize tile, sized by the first step after the dimensions change
+    std::vector<uint64_t> tileVersions_;
+
+    void MarkAllChanged() { allChangedVersion_ = ++version_; }
+    /**
+     * Starts a new version for the tiles a step changed, false if every tile
+     * has been marked as changed instead.
+     */
+    bool BeginChanges();
+    void MarkChanged(const Tile& cells);
+    void MarkEngineChanges();
+
+    bool PlaneInUse() const;
+    void RefreshPlane();
+    /**
+     * Copies chunks of the plane into the window, all of them or only those
+     * that changed in the last step.
+     */
+    void RefreshWindow(bool changedOnly);
+
+    /**
+     * Switches to Engine, carrying the cells over, unless it is already the
+     * one in use.
+     */
+    template <typename Engine>
+    Engine& UseEngine()
+    {
+        if (!std::holds_alternative<Engine>(engine_)) {
+            // Row by row, so that a large grid is never held as doubles all at once
+            Engine engine;
+            engine.Resize(Width(), Height());
+            std::vector<double> row(Width());
+            for (size_t y = 0; y < Height(); ++y) {
+                std::visit([&](const auto& current) { current.ExportRow(y, row.data()); }, engine_);
+                engine.ImportRow(y, row.data());
+            }
+            engine_ = std::move(engine);
+            cellsStale_ = true;
+            planeStale_ = true;
+            MarkAllChanged();
+        }
+        return std::get<Engine>(engine_);
+    }
+};
+
+#endif // AUTOMATON_H
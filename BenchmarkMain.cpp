@@ -0,0 +1,456 @@
+#include "Automaton.h"
+#include "CellPyramid.h"
+#include "BuiltInRules.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+#include "Random.h"
+#include "NeuralNetwork.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdio>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Times stepping every built in rule, and rendering, across grid sizes and
+ * thread counts, e.g.
+ *
+ *     CellularAutomataBenchmark --sizes 100,1024,8192 --threads 1,8 --format csv --output results.csv
+ *
+ * Every run starts from the same seeded grid, so results are comparable
+ * between builds on the same machine. Each benchmark is run warm-up times
+ * untimed and then repetitions times, every repetition steps (or renders)
+ * enough generations to update roughly --work cells.
+ */
+
+struct Options {
+    std::vector<size_t> sizes{ 100, 1024, 8192 };
+    std::vector<unsigned> threadCounts{ 1, std::thread::hardware_concurrency() };
+    std::vector<std::string> rules = BuiltInRuleNames();
+    bool render = true;
+    unsigned warmUp = 1;
+    unsigned repetitions = 5;
+    double work = 1e8;
+    uint64_t seed = 1;
+    std::string format = "json";
+    std::string output;
+};
+
+struct Measurement {
+    std::string benchmark;
+    // The rule stepped, or how cells were coloured when rendering
+    std::string variant;
+    size_t size;
+    unsigned threads;
+    unsigned long long generations;
+    std::vector<double> seconds;
+};
+
+struct Statistics {
+    double mean;
+    double standardDeviation;
+    double min;
+    double median;
+};
+
+static void PrintUsage(std::ostream& out)
+{
+    out << "Usage: CellularAutomataBenchmark [options]\n"
+           "  --sizes N,N,...       square grid sizes, default 100,1024,8192\n"
+           "  --threads N,N,...     thread counts, default 1 and one per core\n"
+           "  --rules NAME;...      rules to step, built in or notation such as B36/S23, default all built in.\n"
+           "                        Separated by ; as notation can hold commas, e.g. \"conway;R5,C0,M1,S34..58,B34..45,NM\"\n"
+           "  --no-render           skip the rendering benchmarks\n"
+           "  --warm-up N           untimed runs before each benchmark, default 1\n"
+           "  --repetitions N       timed runs of each benchmark, default 5\n"
+           "  --work N              cell updates per run, default 1e8, at least one generation is always run\n"
+           "  --seed N              seeds the grids and the neural net, default 1\n"
+           "  --format json|csv     default json\n"
+           "  --output FILE         write results here rather than to stdout\n";
+}
+
+template <typename T>
+static std::vector<T> ParseList(const std::string& list, char separator = ',')
+{
+    std::vector<T> values;
+    std::istringstream stream(list);
+    std::string value;
+    while (std::getline(stream, value, separator)) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            values.push_back(value);
+        } else {
+            values.push_back(static_cast<T>(std::strtoull(value.c_str(), nullptr, 10)));
+        }
+    }
+    return values;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        bool flag = option == "--no-render" || option == "--help";
+        if (!flag && i + 1 >= argc) {
+            std::cerr << option << " needs a value\n";
+            return false;
+        }
+
+        if (option == "--sizes") {
+            options.sizes = ParseList<size_t>(argv[++i]);
+        } else if (option == "--threads") {
+            options.threadCounts = ParseList<unsigned>(argv[++i]);
+        } else if (option == "--rules") {
+            options.rules = ParseList<std::string>(argv[++i], ';');
+        } else if (option == "--no-render") {
+            options.render = false;
+        } else if (option == "--warm-up") {
+            options.warmUp = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--repetitions") {
+            options.repetitions = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--work") {
+            options.work = std::strtod(argv[++i], nullptr);
+        } else if (option == "--seed") {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--format") {
+            options.format = argv[++i];
+        } else if (option == "--output") {
+            options.output = argv[++i];
+        } else {
+            if (option != "--help") {
+                std::cerr << "Unrecognised option " << option << "\n";
+            }
+            return false;
+        }
+    }
+
+    // The defaults repeat themselves on a single core machine
+    std::sort(options.threadCounts.begin(), options.threadCounts.end());
+    options.threadCounts.erase(std::unique(options.threadCounts.begin(), options.threadCounts.end()), options.threadCounts.end());
+
+    if (options.format != "json" && options.format != "csv") {
+        std::cerr << "Unknown format " << options.format << "\n";
+        return false;
+    }
+    for (const std::string& rule : options.rules) {
+        Automaton automaton(1, 1);
+        std::string error;
+        if (!SetBuiltInRule(automaton, rule, error)) {
+            std::cerr << error << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Binary rules start from a soup of 0s and 1s, the neural net from values
+ * spread over [-1, 1].
+ */
+static Grid<double> SeededGrid(size_t size, uint64_t seed, bool binary)
+{
+    std::mt19937_64 entropy(seed);
+    std::uniform_int_distribution<int> bits(0, 1);
+    std::uniform_real_distribution<double> reals(-1.0, 1.0);
+
+    Grid<double> cells(size, size);
+    for (size_t y = 0; y < size; ++y) {
+        double* row = cells.Row(y);
+        for (size_t x = 0; x < size; ++x) {
+            row[x] = binary ? bits(entropy) : reals(entropy);
+        }
+    }
+    return cells;
+}
+
+static unsigned BlockGenerations(const std::string& rule)
+{
+    Automaton automaton(1, 1);
+    std::string error;
+    SetBuiltInRule(automaton, rule, error);
+    return automaton.BlockGenerations();
+}
+
+static unsigned long long GenerationsPerRun(const Options& options, size_t size)
+{
+    double cells = static_cast<double>(size) * static_cast<double>(size);
+    return static_cast<unsigned long long>(std::clamp(options.work / cells, 1.0, 1000.0));
+}
+
+/**
+ * Blocked, several generations are stepped at once, see Automaton::Advance.
+ */
+static Measurement TimeStepping(const Options& options, const std::string& rule, size_t size, unsigned threadCount, bool blocked)
+{
+    ThreadPool threads(threadCount);
+    Automaton automaton(size, size);
+    Random::Seed(static_cast<std::mt19937::result_type>(options.seed));
+    std::string error;
+    SetBuiltInRule(automaton, rule, error);
+    Grid<double> initial = SeededGrid(size, options.seed, rule.rfind("neuralnet", 0) != 0);
+
+    Measurement measurement{ blocked ? "step-blocked" : "step", rule, size, threads.ThreadCount(), GenerationsPerRun(options, size), {} };
+    CellPyramid frame;
+    for (unsigned run = 0; run < options.warmUp + options.repetitions; ++run) {
+        automaton.SetCells(initial);
+
+        auto start = std::chrono::steady_clock::now();
+        if (blocked) {
+            automaton.Advance(measurement.generations, threads);
+        } else {
+            for (unsigned long long generation = 0; generation < measurement.generations; ++generation) {
+                automaton.Step(threads);
+            }
+        }
+        // Includes bringing a copy of the cells up to date, as the GUI would before painting
+        frame.Update(automaton, false, threads);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        if (run >= options.warmUp) {
+            measurement.seconds.push_back(seconds.count());
+        }
+    }
+    return measurement;
+}
+
+static Measurement TimeRendering(const Options& options, bool lookupTable, size_t size, unsigned threadCount)
+{
+    ThreadPool threads(threadCount);
+    Grid<double> cells = SeededGrid(size, options.seed, true);
+    std::vector<uint32_t> pixels(size * size);
+
+    auto colouriser = [](const double& value) -> unsigned { return value == 0 ? 0x00FFFFFF : 0x00000000; };
+    Renderer renderer(colouriser);
+    if (lookupTable) {
+        renderer.SetColouriser(colouriser, 0.0, 1.0);
+    }
+
+    Measurement measurement{ "render", lookupTable ? "lookup-table" : "function", size, threads.ThreadCount(), GenerationsPerRun(options, size), {} };
+    for (unsigned run = 0; run < options.warmUp + options.repetitions; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long long frame = 0; frame < measurement.generations; ++frame) {
+            renderer.Render(cells, Tile{ 0, size, 0, size }, pixels.data(), static_cast<ptrdiff_t>(size), threads);
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        if (run >= options.warmUp) {
+            measurement.seconds.push_back(seconds.count());
+        }
+    }
+    return measurement;
+}
+
+/**
+ * The largest difference between the outputs of float copies of random
+ * networks and their double originals, for random inputs between -1.0 and
+ * 1.0. The float rule is only a faithful stand-in while this is within
+ * NeuralNetwork::FloatTolerance.
+ */
+static double NeuralNetFloatError(uint64_t seed)
+{
+    constexpr unsigned NetworkCount = 16;
+    constexpr size_t BatchSize = 4096;
+
+    Random::Seed(static_cast<std::mt19937::result_type>(seed));
+    std::mt19937_64 entropy(seed);
+    std::uniform_real_distribution<double> reals(-1.0, 1.0);
+
+    double maxError = 0.0;
+    for (unsigned network = 0; network < NetworkCount; ++network) {
+        NeuralNetwork<double> reference(3, 8, NeuralNetwork<double>::InitialWeights::Random);
+        NeuralNetwork<float> copy(reference);
+
+        std::vector<double> inputs(BatchSize * reference.GetInputCount());
+        std::generate(inputs.begin(), inputs.end(), [&]() { return reals(entropy); });
+        std::vector<float> floatInputs(inputs.begin(), inputs.end());
+        std::vector<double> outputs(BatchSize * reference.GetOutputCount());
+        std::vector<float> floatOutputs(outputs.size());
+        std::vector<double> scratch;
+        std::vector<float> floatScratch;
+        reference.ForwardPropogate(inputs.data(), outputs.data(), BatchSize, scratch);
+        copy.ForwardPropogate(floatInputs.data(), floatOutputs.data(), BatchSize, floatScratch);
+
+        for (size_t index = 0; index < outputs.size(); ++index) {
+            maxError = std::max(maxError, std::abs(outputs[index] - static_cast<double>(floatOutputs[index])));
+        }
+    }
+    return maxError;
+}
+
+static Statistics Summarise(std::vector<double> seconds)
+{
+    Statistics statistics;
+    double count = static_cast<double>(seconds.size());
+    statistics.mean = std::accumulate(seconds.begin(), seconds.end(), 0.0) / count;
+    double squares = 0.0;
+    for (double sample : seconds) {
+        squares += (sample - statistics.mean) * (sample - statistics.mean);
+    }
+    // Sample standard deviation, zero when there is only the one sample
+    statistics.standardDeviation = seconds.size() > 1 ? std::sqrt(squares / (count - 1.0)) : 0.0;
+    std::sort(seconds.begin(), seconds.end());
+    statistics.min = seconds.front();
+    size_t middle = seconds.size() / 2;
+    statistics.median = seconds.size() % 2 ? seconds[middle] : (seconds[middle - 1] + seconds[middle]) / 2.0;
+    return statistics;
+}
+
+static double CellsPerSecond(const Measurement& measurement, const Statistics& statistics)
+{
+    double cells = static_cast<double>(measurement.size) * static_cast<double>(measurement.size);
+    return (cells * static_cast<double>(measurement.generations)) / statistics.mean;
+}
+
+/**
+ * Quoted, variants are rule notation as given on the command line so may hold anything.
+ */
+static std::string JsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/**
+ * Quoted if it holds a comma, quote or line break, with quotes doubled, see RFC 4180.
+ */
+static std::string CsvField(const std::string& text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        return text;
+    }
+    std::string quoted = "\"";
+    for (char c : text) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + "\"";
+}
+
+static void WriteJson(std::ostream& out, const Options& options, double neuralNetFloatError, const std::vector<Measurement>& measurements)
+{
+    out << "{\n"
+        << "  \"seed\": " << options.seed << ",\n"
+        << "  \"warmUp\": " << options.warmUp << ",\n"
+        << "  \"repetitions\": " << options.repetitions << ",\n"
+        << "  \"hardwareConcurrency\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"neuralNetFloatMaxError\": " << neuralNetFloatError << ",\n"
+        << "  \"results\": [\n";
+    for (size_t i = 0; i < measurements.size(); ++i) {
+        const Measurement& measurement = measurements[i];
+        Statistics statistics = Summarise(measurement.seconds);
+        out << "    {\"benchmark\": " << JsonString(measurement.benchmark)
+            << ", \"variant\": " << JsonString(measurement.variant)
+            << ", \"width\": " << measurement.size
+            << ", \"height\": " << measurement.size
+            << ", \"threads\": " << measurement.threads
+            << ", \"generations\": " << measurement.generations
+            << ", \"meanSeconds\": " << statistics.mean
+            << ", \"standardDeviationSeconds\": " << statistics.standardDeviation
+            << ", \"minSeconds\": " << statistics.min
+            << ", \"medianSeconds\": " << statistics.median
+            << ", \"cellsPerSecond\": " << CellsPerSecond(measurement, statistics)
+            << ", \"samples\": [";
+        for (size_t sample = 0; sample < measurement.seconds.size(); ++sample) {
+            out << (sample == 0 ? "" : ", ") << measurement.seconds[sample];
+        }
+        out << "]}" << (i + 1 < measurements.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n"
+        << "}\n";
+}
+
+static void WriteCsv(std::ostream& out, const std::vector<Measurement>& measurements)
+{
+    out << "benchmark,variant,width,height,threads,generations,mean_s,stddev_s,min_s,median_s,cells_per_s\n";
+    for (const Measurement& measurement : measurements) {
+        Statistics statistics = Summarise(measurement.seconds);
+        out << CsvField(measurement.benchmark) << ","
+            << CsvField(measurement.variant) << ","
+            << measurement.size << ","
+            << measurement.size << ","
+            << measurement.threads << ","
+            << measurement.generations << ","
+            << statistics.mean << ","
+            << statistics.standardDeviation << ","
+            << statistics.min << ","
+            << statistics.median << ","
+            << CellsPerSecond(measurement, statistics) << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(std::cerr);
+        return 1;
+    }
+
+    double neuralNetFloatError = NeuralNetFloatError(options.seed);
+    bool accurate = neuralNetFloatError <= NeuralNetwork<float>::FloatTolerance;
+    std::cerr << "float neural net max error " << neuralNetFloatError << (accurate ? "\n" : ", beyond NeuralNetwork::FloatTolerance\n");
+
+    std::vector<Measurement> measurements;
+    auto report = [&](const Measurement& measurement)
+    {
+        // Progress goes to stderr so that stdout is only the results
+        std::cerr << measurement.benchmark << " " << measurement.variant << " " << measurement.size << "x" << measurement.size
+                  << " on " << measurement.threads << " threads: " << Summarise(measurement.seconds).mean << "s per run\n";
+        measurements.push_back(measurement);
+    };
+
+    for (size_t size : options.sizes) {
+        for (unsigned threadCount : options.threadCounts) {
+            for (const std::string& rule : options.rules) {
+                report(TimeStepping(options, rule, size, threadCount, false));
+                if (BlockGenerations(rule) > 1) {
+                    report(TimeStepping(options, rule, size, threadCount, true));
+                }
+            }
+            if (options.render) {
+                report(TimeRendering(options, true, size, threadCount));
+                report(TimeRendering(options, false, size, threadCount));
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file) {
+            std::cerr << "Couldn't open " << options.output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    out.precision(9);
+    if (options.format == "json") {
+        WriteJson(out, options, neuralNetFloatError, measurements);
+    } else {
+        WriteCsv(out, measurements);
+    }
+    // So that a regression in the float network's accuracy fails a benchmark run
+    return accurate ? 0 : 2;
+}
@@ -0,0 +1,76 @@
+#include "BuiltInRules.h"
+
+#include "Rules.h"
+#include "LifeRule.h"
+#include "TableRule.h"
+#include "NeuralNetwork.h"
+
+#include <memory>
+#include <optional>
+#include <sstream>
+
+const std::vector<std::string>& BuiltInRuleNames()
+{
+    static const std::vector<std::string> names{ "conway", "conway-stencil", "neuralnet", "neuralnet-double", "multipleneighbourhoods", "lenia" };
+    return names;
+}
+
+/**
+ * Sets network as the rule, and writes it to ruleData.
+ */
+template <typename Scalar>
+static void SetNeuralNetRule(Automaton& automaton, std::shared_ptr<const NeuralNetwork<Scalar>> network, std::string& ruleData)
+{
+    std::ostringstream out;
+    network->Write(out);
+    ruleData = out.str();
+    automaton.SetCellRule(NeuralNetRule<Scalar>{ std::move(network) });
+}
+
+bool SetBuiltInRule(Automaton& automaton, const std::string& name, std::string& error)
+{
+    std::string ruleData;
+    return SetBuiltInRule(automaton, name, ruleData, error);
+}
+
+bool SetBuiltInRule(Automaton& automaton, const std::string& name, std::string& ruleData, std::string& error)
+{
+    if (name == "neuralnet" || name == "neuralnet-double") {
+        // Both are drawn in double, so the same Random state gives the same network either way
+        std::optional<NeuralNetwork<double>> network;
+        if (ruleData.empty()) {
+            network.emplace(3, 8, NeuralNetwork<double>::InitialWeights::Random);
+        } else {
+            // A float network's weights are written with enough digits to round trip through double
+            std::istringstream in(ruleData);
+            network = NeuralNetwork<double>::Read(in);
+            if (!network || network->GetInputCount() != NeuralNetRule<double>::Coordinates.size() || network->GetOutputCount() <= 4) {
+                error = "The " + name + " rule's weights are corrupt";
+                return false;
+            }
+        }
+        if (name == "neuralnet") {
+            SetNeuralNetRule<float>(automaton, std::make_shared<NeuralNetwork<float>>(*network), ruleData);
+        } else {
+            SetNeuralNetRule<double>(automaton, std::make_shared<NeuralNetwork<double>>(*network), ruleData);
+        }
+        return true;
+    }
+
+    ruleData.clear();
+    if (name == "conway") {
+        automaton.SetCellRule(LifeRule::Conway());
+    } else if (name == "conway-stencil") {
+        automaton.SetCellRule(ConwayRule());
+    } else if (name == "multipleneighbourhoods") {
+        automaton.SetCellRule(MultipleNeighbourhoodsRule());
+    } else if (name == "lenia") {
+        automaton.SetCellRule(LeniaRule::Orbium());
+    } else if (std::optional<TableRule> rule = TableRule::Compile(name, error)) {
+        automaton.SetCellRule(std::move(*rule));
+    } else {
+        error = "Unknown rule " + name + ", " + error;
+        return false;
+    }
+    return true;
+}
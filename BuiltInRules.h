@@ -0,0 +1,39 @@
+#ifndef BUILTINRULES_H
+#define BUILTINRULES_H
+
+#include "Automaton.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * The rules in Rules.h, LifeRule.h and LeniaEngine.h by name, or any rule in
+ * the notation TableRule understands, for tools that pick a rule from the
+ * command line.
+ */
+
+/**
+ * conway, conway-stencil, neuralnet, neuralnet-double,
+ * multipleneighbourhoods and lenia. conway-stencil is Conway's game of life
+ * stepped by the generic stencil kernel rather than LifeEngine, and
+ * neuralnet-double is the reference double precision network neuralnet is a
+ * float copy of, both for comparison. lenia is LeniaRule::Orbium().
+ */
+const std::vector<std::string>& BuiltInRuleNames();
+
+/**
+ * Names that aren't built in are compiled as rule notation, e.g. B36/S23.
+ * False, and error says why, if it is neither. The neural net is randomly
+ * generated, from Random's current state.
+ */
+bool SetBuiltInRule(Automaton& automaton, const std::string& name, std::string& error);
+/**
+ * As above, for rules the name alone doesn't pin down, e.g. so Checkpoint can
+ * save and restore them. If ruleData isn't empty the rule is restored from it,
+ * e.g. the neural net's weights as NeuralNetwork::Write writes them, rather
+ * than generated afresh. Either way it is left holding the rule's data, empty
+ * for rules that have none.
+ */
+bool SetBuiltInRule(Automaton& automaton, const std::string& name, std::string& ruleData, std::string& error);
+
+#endif // BUILTINRULES_H
@@ -0,0 +1,52 @@
+#ifndef CELLHASH_H
+#define CELLHASH_H
+
+#include <cstring>
+#include <type_traits>
+#include <stdint.h>
+
+/**
+ * Zobrist style hashing of a grid's cells. The hash of a grid is the XOR of
+ * Of(position, value) for each of its cells, or words of cells, so a step only
+ * has to XOR in Of(position, old) ^ Of(position, new) for each one it changed
+ * to keep the hash up to date, rather than rescanning the whole grid.
+ *
+ * Zero values hash to zero, so empty space costs nothing and a grid's hash
+ * doesn't depend on how much of it is empty.
+ */
+class CellHash {
+public:
+    static uint64_t Of(uint64_t position, uint64_t value)
+    {
+        return value == 0 ? 0 : Mix(Mix(position) ^ value);
+    }
+
+    /**
+     * A cell as the value to hash. Cells that compare equal have the same
+     * bits, i.e. -0.0 is 0.
+     */
+    template <typename CellType>
+    static uint64_t Bits(CellType cell)
+    {
+        if (cell == CellType{ 0 }) {
+            return 0;
+        } else if constexpr (std::is_integral_v<CellType>) {
+            return static_cast<uint64_t>(cell);
+        } else {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &cell, sizeof(cell));
+            return bits;
+        }
+    }
+
+private:
+    // SplitMix64's finaliser, every input bit affects every output bit
+    static uint64_t Mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+};
+
+#endif // CELLHASH_H
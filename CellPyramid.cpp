@@ -0,0 +1,215 @@
+#include "CellPyramid.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+static size_t TilesAcross(size_t cells)
+{
+    return (cells + CellPyramid::TileSize - 1) / CellPyramid::TileSize;
+}
+
+// Rounded up, an odd row or column at the edge is averaged with itself
+static size_t Half(size_t cells)
+{
+    return (cells + 1) / 2;
+}
+
+// Where cell x starts in a row, or for bits the end of the word holding cell x - 1
+static size_t ByteOffset(Automaton::CellFormat format, size_t x)
+{
+    switch (format) {
+    case Automaton::CellFormat::Bits:
+        return ((x + 63) / 64) * sizeof(uint64_t);
+    case Automaton::CellFormat::UInt8:
+        return x;
+    case Automaton::CellFormat::Float:
+        return x * sizeof(float);
+    case Automaton::CellFormat::Double:
+        break;
+    }
+    return x * sizeof(double);
+}
+
+template <typename CellType>
+static void ReadCells(const uint8_t* row, size_t firstX, size_t lastX, double* values)
+{
+    for (size_t x = firstX; x < lastX; ++x) {
+        CellType cell;
+        std::memcpy(&cell, row + (x * sizeof(CellType)), sizeof(CellType));
+        *values++ = static_cast<double>(cell);
+    }
+}
+
+/**
+ * Converts cells [firstX, lastX) of a row stored in format to doubles.
+ */
+static void ReadCells(Automaton::CellFormat format, const uint8_t* row, size_t firstX, size_t lastX, double* values)
+{
+    switch (format) {
+    case Automaton::CellFormat::Bits:
+        for (size_t x = firstX; x < lastX; ++x) {
+            uint64_t word;
+            std::memcpy(&word, row + ((x / 64) * sizeof(uint64_t)), sizeof(uint64_t));
+            *values++ = static_cast<double>((word >> (x % 64)) & 1);
+        }
+        break;
+    case Automaton::CellFormat::UInt8:
+        ReadCells<uint8_t>(row, firstX, lastX, values);
+        break;
+    case Automaton::CellFormat::Float:
+        ReadCells<float>(row, firstX, lastX, values);
+        break;
+    case Automaton::CellFormat::Double:
+        ReadCells<double>(row, firstX, lastX, values);
+        break;
+    }
+}
+
+/**
+ * Writes a row of the next level up from the 2 x 2 cells under each, the rows
+ * above and below holding belowCount cells from the first under it. A missing
+ * row or column at the edge reads the last one twice, which leaves the mean
+ * and maximum of the cells that are there unchanged.
+ */
+template <typename CellType>
+static void ReduceRow(const CellType* above, const CellType* below, size_t belowCount, bool maxima, float* cells)
+{
+    for (size_t x = 0; 2 * x < belowCount; ++x) {
+        size_t left = 2 * x;
+        size_t right = std::min(left + 1, belowCount - 1);
+        if (maxima) {
+            cells[x] = static_cast<float>(std::max({ above[left], above[right], below[left], below[right] }));
+        } else {
+            double sum = static_cast<double>(above[left]) + above[right] + below[left] + below[right];
+            cells[x] = static_cast<float>(sum * 0.25);
+        }
+    }
+}
+
+void CellPyramid::Update(const Automaton& automaton, bool maxima, ThreadPool& threads)
+{
+    PROFILE_SCOPE("Update pyramid");
+    if (dirty_.empty() || automaton.Width() != width_ || automaton.Height() != height_ || automaton.Format() != format_ || maxima != maxima_) {
+        Reshape(automaton, maxima);
+    } else {
+        std::vector<uint8_t>& dirty = dirty_[0];
+        for (size_t tile = 0; tile < dirty.size(); ++tile) {
+            dirty[tile] = automaton.TileVersion(tile) > version_;
+        }
+    }
+    version_ = automaton.Version();
+
+    size_t tileColumns = TilesAcross(width_);
+    dirtyTiles_.clear();
+    for (size_t tile = 0; tile < dirty_[0].size(); ++tile) {
+        if (dirty_[0][tile]) {
+            dirtyTiles_.push_back(tile);
+        }
+    }
+    threads.ParallelFor(dirtyTiles_.size(), [&](size_t index)
+    {
+        size_t firstX = (dirtyTiles_[index] % tileColumns) * TileSize;
+        size_t firstY = (dirtyTiles_[index] / tileColumns) * TileSize;
+        size_t firstByte = ByteOffset(format_, firstX);
+        size_t lastByte = ByteOffset(format_, std::min(firstX + TileSize, width_));
+        for (size_t y = firstY; y < std::min(firstY + TileSize, height_); ++y) {
+            std::memcpy(cells_.data() + (y * rowBytes_) + firstByte, static_cast<const uint8_t*>(automaton.RowData(y)) + firstByte, lastByte - firstByte);
+        }
+    });
+
+    for (size_t level = 1; level < LevelCount(); ++level) {
+        const std::vector<uint8_t>& below = dirty_[level - 1];
+        std::vector<uint8_t>& above = dirty_[level];
+        size_t belowWidth = level == 1 ? width_ : levels_[level - 2].Width();
+        size_t belowHeight = level == 1 ? height_ : levels_[level - 2].Height();
+        size_t belowColumns = TilesAcross(belowWidth);
+        size_t belowRows = below.size() / belowColumns;
+        Grid<float>& levelCells = levels_[level - 1];
+        size_t columns = TilesAcross(levelCells.Width());
+
+        // A tile covers the 2 x 2 tiles under it
+        dirtyTiles_.clear();
+        for (size_t tile = 0; tile < above.size(); ++tile) {
+            size_t belowX = (tile % columns) * 2;
+            size_t belowY = (tile / columns) * 2;
+            for (size_t y = belowY; y < std::min(belowY + 2, belowRows); ++y) {
+                for (size_t x = belowX; x < std::min(belowX + 2, belowColumns); ++x) {
+                    above[tile] |= below[(y * belowColumns) + x];
+                }
+            }
+            if (above[tile]) {
+                dirtyTiles_.push_back(tile);
+            }
+        }
+
+        threads.ParallelFor(dirtyTiles_.size(), [&](size_t index)
+        {
+            size_t firstX = (dirtyTiles_[index] % columns) * TileSize;
+            size_t firstY = (dirtyTiles_[index] / columns) * TileSize;
+            size_t lastX = std::min(firstX + TileSize, levelCells.Width());
+            size_t lastY = std::min(firstY + TileSize, levelCells.Height());
+            size_t belowFirstX = 2 * firstX;
+            size_t belowCount = std::min(2 * lastX, belowWidth) - belowFirstX;
+            thread_local std::vector<double> cellsAbove;
+            thread_local std::vector<double> cellsBelow;
+            cellsAbove.resize(belowCount);
+            cellsBelow.resize(belowCount);
+            for (size_t y = firstY; y < lastY; ++y) {
+                size_t top = 2 * y;
+                size_t bottom = std::min(top + 1, belowHeight - 1);
+                float* cells = levelCells.Row(y) + firstX;
+                if (level == 1) {
+                    // Level 0 is converted a row of the tile at a time
+                    ReadCells(format_, Row(top), belowFirstX, belowFirstX + belowCount, cellsAbove.data());
+                    ReadCells(format_, Row(bottom), belowFirstX, belowFirstX + belowCount, cellsBelow.data());
+                    ReduceRow(cellsAbove.data(), cellsBelow.data(), belowCount, maxima_, cells);
+                } else {
+                    const Grid<float>& belowCells = levels_[level - 2];
+                    ReduceRow(belowCells.Row(top) + belowFirstX, belowCells.Row(bottom) + belowFirstX, belowCount, maxima_, cells);
+                }
+            }
+        });
+    }
+
+    for (std::vector<uint8_t>& levelDirty : dirty_) {
+        std::fill(levelDirty.begin(), levelDirty.end(), 0);
+    }
+}
+
+void CellPyramid::ExportRegion(const Tile& region, Grid<double>& cells, ThreadPool& threads) const
+{
+    size_t width = region.lastX - region.firstX;
+    size_t height = region.lastY - region.firstY;
+    if (cells.Width() != width || cells.Height() != height) {
+        cells = Grid<double>(width, height, 0);
+    }
+    threads.ParallelFor(height, [&](size_t y)
+    {
+        ReadCells(format_, Row(region.firstY + y), region.firstX, region.lastX, cells.Row(y));
+    });
+}
+
+void CellPyramid::Reshape(const Automaton& automaton, bool maxima)
+{
+    width_ = automaton.Width();
+    height_ = automaton.Height();
+    format_ = automaton.Format();
+    rowBytes_ = automaton.RowBytes();
+    maxima_ = maxima;
+    cells_.assign(height_ * rowBytes_, 0);
+    levels_.clear();
+    dirty_.clear();
+    // Everything is copied and recomputed, whatever changed
+    dirty_.emplace_back(TilesAcross(width_) * TilesAcross(height_), 1);
+
+    size_t levelWidth = width_;
+    size_t levelHeight = height_;
+    while (levelWidth != 0 && levelHeight != 0 && (levelWidth > 1 || levelHeight > 1)) {
+        levelWidth = Half(levelWidth);
+        levelHeight = Half(levelHeight);
+        levels_.emplace_back(levelWidth, levelHeight, 0);
+        dirty_.emplace_back(TilesAcross(levelWidth) * TilesAcross(levelHeight), 1);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef CELLPYRAMID_H
+#define CELLPYRAMID_H
+
+#include "Automaton.h"
+#include "Grid.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * A copy of an Automaton's cells along with mipmaps of them, for drawing them
+ * zoomed out from only as many cells as there are pixels. Each level is half
+ * the width and height of the one below, rounded up, each of its cells
+ * holding either the mean or the maximum of the 2 x 2 cells under it, until a
+ * level is a single cell. Level 0 is the cells themselves, kept exactly as the
+ * automaton's engine stores them, see Automaton::RowData, and the levels
+ * above it add 4 / 3 bytes a cell as floats.
+ *
+ * Updating only copies the tiles the automaton changed since this copy was
+ * last updated, see Automaton::TileVersion, and only recomputes the parts of
+ * each level above those tiles, so a pyramid of a mostly settled grid costs
+ * next to nothing to keep up to date.
+ */
+class CellPyramid {
+public:
+    // Cells across each side of the tiles copied and recomputed, at every level
+    static constexpr size_t TileSize = Automaton::ChangeTileSize;
+
+    size_t Width() const { return width_; }
+    size_t Height() const { return height_; }
+
+    /**
+     * Brings every level up to date with the automaton's cells, reshaping if
+     * their dimensions or format changed, or if maxima changed.
+     */
+    void Update(const Automaton& automaton, bool maxima, ThreadPool& threads);
+
+    /**
+     * The region of level 0 as doubles, cells being resized to fit it.
+     */
+    void ExportRegion(const Tile& region, Grid<double>& cells, ThreadPool& threads) const;
+
+    /**
+     * Including level 0, at least 1.
+     */
+    size_t LevelCount() const { return levels_.size() + 1; }
+    /**
+     * From level 1 to LevelCount() - 1, each cell covers 2^level x 2^level
+     * cells of level 0, fewer at the right and bottom edges.
+     */
+    const Grid<float>& Level(size_t level) const { return levels_[level - 1]; }
+
+private:
+    size_t width_ = 0;
+    size_t height_ = 0;
+    Automaton::CellFormat format_ = Automaton::CellFormat::Bits;
+    size_t rowBytes_ = 0;
+    // Level 0, rowBytes_ a row
+    std::vector<uint8_t> cells_;
+    // The Automaton::Version() last updated to
+    uint64_t version_ = 0;
+    bool maxima_ = false;
+    std::vector<Grid<float>> levels_;
+    // Of each level's tiles, row by row, whether they need recomputing
+    std::vector<std::vector<uint8_t>> dirty_;
+    std::vector<size_t> dirtyTiles_;
+
+    const uint8_t* Row(size_t y) const { return cells_.data() + (y * rowBytes_); }
+    void Reshape(const Automaton& automaton, bool maxima);
+};
+
+#endif // CELLPYRAMID_H
@@ -1,72 +1,296 @@
 #include "CellularAutomata.h"
 
-#include "Random.h"
-#include "Neighbourhood.h"
-
 #include <QMouseEvent>
 #include <QPainter>
 
+#include <algorithm>
+#include <cmath>
+
 CellularAutomata::CellularAutomata(QWidget* parent, unsigned rows, unsigned columns)
     : QWidget(parent)
-    , cells(rows, std::vector<double>(columns))
-    , nextCells(rows, std::vector<double>(columns))
-    , stepCell_(GetDefaultCellStepper())
-    , colouriser_(GetDefaultCellColouriser())
+    , automaton_(columns, rows)
+    , renderer_(GetDefaultCellColouriser())
 {
+    SetCellColouriser(GetDefaultCellColouriser(), 0.0, 1.0);
+    {
+        auto lock = LockState();
+        PublishFrame();
+    }
+    simulation_ = std::thread([this]() { SimulationLoop(); });
 }
 
-void CellularAutomata::Step()
+CellularAutomata::~CellularAutomata()
 {
-    for (size_t row = 0; row < cells.size(); row++) {
-        // TODO calculate each row in threadpool
-        for (size_t column = 0; column < cells[row].size(); column++) {
-            GetNeighbourFunc getNeighbourFunc = [&](int offsetX, int offsetY) -> const double& { return GetCellValue(row, column, offsetX, offsetY); };
-            nextCells[row][column] = stepCell_(getNeighbourFunc);
-        }
+    {
+        auto lock = LockState();
+        stopping_ = true;
+        jumpCancelled_ = true;
+        simulationWake_.notify_all();
     }
-    std::swap(cells, nextCells);
-    update();
+    simulation_.join();
 }
 
-const double& CellularAutomata::GetCellValue(size_t x, size_t y, int offsetX, int offsetY) const
+void CellularAutomata::SetRunning(bool running)
 {
-    int64_t intX = x + offsetX;
-    int64_t intY = y + offsetY;
-    return cells[intX % cells.size()][intY % cells[x].size()];
+    auto lock = LockState();
+    running_ = running;
+    simulationWake_.notify_all();
 }
 
-void CellularAutomata::Clear(double value)
+void CellularAutomata::SetStepInterval(std::chrono::milliseconds interval)
+{
+    auto lock = LockState();
+    stepInterval_ = interval;
+    simulationWake_.notify_all();
+}
+
+void CellularAutomata::Step()
+{
+    auto lock = LockState();
+    automaton_.Step(threads_);
+    PublishFrame();
+}
+
+std::unique_lock<std::mutex> CellularAutomata::LockState() const
 {
-    for (unsigned x = 1; x < cells.size() - 1; x++) {
-        for (unsigned y = 1; y < cells[x].size() - 1; y++) {
-            cells[x][y] = value;
-            nextCells[x][y] = value;
+    ++stateWaiters_;
+    std::unique_lock lock(stateMutex_);
+    --stateWaiters_;
+    // The simulation thread may be waiting for us to finish
+    simulationWake_.notify_all();
+    return lock;
+}
+
+void CellularAutomata::SimulationLoop()
+{
+    std::unique_lock lock(stateMutex_);
+    Clock::time_point lastStep = Clock::now();
+    while (!stopping_) {
+        // Mutexes aren't fair, without this a thread stepping flat out could starve the GUI
+        if (stateWaiters_.load() > 0) {
+            simulationWake_.wait(lock, [&]() { return stateWaiters_.load() == 0; });
+            continue;
+        }
+
+        if (jumping_) {
+            StepJump(lock);
+            continue;
+        }
+
+        Clock::time_point nextStep = lastStep + stepInterval_;
+        if (!running_ || Clock::now() < nextStep) {
+            if (framePending_) {
+                PublishFrame();
+            }
+            if (running_) {
+                simulationWake_.wait_until(lock, nextStep);
+            } else {
+                simulationWake_.wait(lock);
+            }
+            continue;
+        }
+
+        lastStep = Clock::now();
+        automaton_.Step(threads_);
+        bool settled = automaton_.Period() != 0;
+        if (settled && !settled_) {
+            running_ = false;
+            quint64 generation = automaton_.Generation();
+            quint64 period = automaton_.Period();
+            QMetaObject::invokeMethod(this, [=]() { emit Settled(generation, period); }, Qt::QueuedConnection);
+        }
+        settled_ = settled;
+        // Flat out there is no point copying out generations faster than they can be painted
+        if (frames_.Unread()) {
+            framePending_ = true;
+        } else {
+            PublishFrame();
         }
     }
 }
 
-std::function<double (const std::function<const double& (int, int)>& getCellValue)> CellularAutomata::GetDefaultCellStepper() const
+void CellularAutomata::PublishFrame()
 {
-    // Conways game of life
-    return [](const GetNeighbourFunc& getCellValue) -> double
-    {
-        static auto neighbourhood = Neighbourhood::CreateNeighbourhoodCoordinates(
-                                    {
-                                        { 1, 1, 1 },
-                                        { 1, 0, 1 },
-                                        { 1, 1, 1 },
-                                    });
-        double neighbours = 0.0;
-        for (auto coord : neighbourhood) {
-            neighbours += getCellValue(coord.first, coord.second);
+    PROFILE_SCOPE("Publish frame");
+    frames_.Back().Update(automaton_, zoomedOutMaxima_, threads_);
+    frames_.Publish();
+    frameGeneration_ = automaton_.Generation();
+    framePending_ = false;
+
+    // Only one repaint is queued at a time, however many frames are published
+    if (!repaintPending_.exchange(true)) {
+        QMetaObject::invokeMethod(this, [this]() { update(); }, Qt::QueuedConnection);
+    }
+}
+
+void CellularAutomata::FastForward(unsigned log2Generations)
+{
+    auto lock = LockState();
+    StopJump();
+    jumping_ = true;
+    jumpLog2Generations_ = log2Generations;
+    jumpFrom_ = automaton_.Generation();
+    jumpTo_ = jumpFrom_ + (uint64_t{ 1 } << log2Generations);
+    simulationWake_.notify_all();
+}
+
+void CellularAutomata::CancelJump()
+{
+    auto lock = LockState();
+    StopJump();
+}
+
+void CellularAutomata::StepJump(std::unique_lock<std::mutex>& lock)
+{
+    // HashLife gets there in one go, or gives up, within its node limit
+    if (automaton_.Generation() == jumpFrom_ && automaton_.BeginHashLifeJump(jumpLog2Generations_, hashLife_)) {
+        // Without the lock, so the GUI isn't held up for the whole go and can cancel it part way
+        uint64_t version = automaton_.Version();
+        jumpCancelled_ = false;
+        lock.unlock();
+        bool jumped = hashLife_.Advance(jumpLog2Generations_, &jumpCancelled_);
+        lock.lock();
+        if (jumpCancelled_) {
+            // Whatever cancelled it has already finished the jump
+            return;
+        } else if (jumped && automaton_.Generation() == jumpFrom_ && automaton_.Version() == version) {
+            automaton_.EndHashLifeJump(jumpLog2Generations_, hashLife_);
+            FinishJump(false);
+            return;
         }
+    }
 
-        if (neighbours == 3 || (getCellValue(0, 0) != 0.0 && neighbours == 2.0)) {
-            return 1.0;
+    Clock::time_point sliceEnd = Clock::now() + JumpSlice;
+    while (automaton_.Generation() < jumpTo_ && Clock::now() < sliceEnd) {
+        if (automaton_.Period() != 0) {
+            // Skips whole periods at once
+            automaton_.StepTo(jumpTo_, threads_);
         } else {
-            return 0.0;
+            automaton_.Step(threads_);
         }
-    };
+    }
+    if (automaton_.Generation() >= jumpTo_) {
+        FinishJump(false);
+        return;
+    }
+
+    quint64 done = automaton_.Generation() - jumpFrom_;
+    quint64 generations = jumpTo_ - jumpFrom_;
+    QMetaObject::invokeMethod(this, [=]() { emit JumpProgress(done, generations); }, Qt::QueuedConnection);
+    if (frames_.Unread()) {
+        framePending_ = true;
+    } else {
+        PublishFrame();
+    }
+}
+
+void CellularAutomata::FinishJump(bool cancelled)
+{
+    jumping_ = false;
+    PublishFrame();
+    QMetaObject::invokeMethod(this, [=]() { emit JumpFinished(cancelled); }, Qt::QueuedConnection);
+}
+
+void CellularAutomata::StopJump()
+{
+    if (jumping_) {
+        jumpCancelled_ = true;
+        FinishJump(true);
+    }
+}
+
+void CellularAutomata::SetShowStats(bool show)
+{
+    showStats_ = show;
+    statsSince_ = Clock::now();
+    statsGeneration_ = frameGeneration_.load();
+    generationsPerSecond_ = 0.0;
+    statsThreads_ = threads_.Stats();
+    threadStatsText_.clear();
+    update();
+}
+
+void CellularAutomata::SetZoomedOutMaxima(bool maxima)
+{
+    auto lock = LockState();
+    zoomedOutMaxima_ = maxima;
+    PublishFrame();
+}
+
+size_t CellularAutomata::TilesProcessed() const
+{
+    auto lock = LockState();
+    return automaton_.TilesProcessed();
+}
+
+size_t CellularAutomata::TileCount() const
+{
+    auto lock = LockState();
+    return automaton_.TileCount();
+}
+
+double CellularAutomata::GetCellValue(size_t x, size_t y, int offsetX, int offsetY) const
+{
+    auto lock = LockState();
+    return automaton_.GetCellValue(x, y, offsetX, offsetY);
+}
+
+bool CellularAutomata::SaveCheckpoint(const std::string& path, const std::string& rule, const std::string& ruleData, uint64_t seed, std::string& error)
+{
+    auto lock = LockState();
+    return Checkpoint::Save(path, automaton_, rule, ruleData, seed, true, threads_, error);
+}
+
+std::optional<Checkpoint::Info> CellularAutomata::LoadCheckpoint(const std::string& path, const Checkpoint::RuleSetter& setRule, std::string& error)
+{
+    auto lock = LockState();
+    StopJump();
+    std::optional<Checkpoint::Info> info = Checkpoint::Load(path, automaton_, setRule, threads_, error);
+    PublishFrame();
+    return info;
+}
+
+bool CellularAutomata::ReadPattern(std::istream& in, const Pattern::RleHeader& header, std::string& error)
+{
+    auto lock = LockState();
+    StopJump();
+    bool read = Pattern::ReadRleCells(in, header, automaton_, error);
+    PublishFrame();
+    return read;
+}
+
+bool CellularAutomata::WritePattern(std::ostream& out, const std::string& rule, bool macrocell)
+{
+    auto lock = LockState();
+    return macrocell ? Pattern::WriteMacrocell(out, automaton_, rule) : Pattern::WriteRle(out, automaton_, rule);
+}
+
+void CellularAutomata::Clear(double value)
+{
+    auto lock = LockState();
+    StopJump();
+    automaton_.Clear(value);
+    PublishFrame();
+}
+
+void CellularAutomata::SetDimensions(size_t width, size_t height)
+{
+    auto lock = LockState();
+    StopJump();
+    automaton_.SetDimensions(width, height);
+    PublishFrame();
+}
+
+void CellularAutomata::SetUnbounded(bool unbounded)
+{
+    auto lock = LockState();
+    StopJump();
+    automaton_.SetUnbounded(unbounded);
+}
+
+std::function<double (const std::function<const double& (int, int)>& getCellValue)> CellularAutomata::GetDefaultCellStepper() const
+{
+    return Automaton::GetDefaultCellStepper();
 }
 
 std::function<unsigned (const double& value)> CellularAutomata::GetDefaultCellColouriser() const
@@ -77,14 +301,22 @@ std::function<unsigned (const double& value)> CellularAutomata::GetDefaultCellCo
     };
 }
 
-void CellularAutomata::SetCellStepper(std::function<double(const GetNeighbourFunc&)>&& stepper)
+void CellularAutomata::SetCellStepper(std::function<double(const GetNeighbourFunc&)>&& stepper, unsigned radius)
 {
-    stepCell_ = std::move(stepper);
+    auto lock = LockState();
+    StopJump();
+    automaton_.SetCellStepper(std::move(stepper), radius);
 }
 
 void CellularAutomata::SetCellColouriser(std::function<unsigned (const double&)>&& converter)
 {
-    colouriser_ = std::move(converter);
+    renderer_.SetColouriser(std::move(converter));
+    update();
+}
+
+void CellularAutomata::SetCellColouriser(std::function<unsigned (const double&)>&& converter, double min, double max)
+{
+    renderer_.SetColouriser(std::move(converter), min, max);
     update();
 }
 
@@ -97,14 +329,119 @@ void CellularAutomata::wheelEvent(QWheelEvent* event)
 
 void CellularAutomata::paintEvent(QPaintEvent* /*event*/)
 {
+    PROFILE_SCOPE("Paint");
+    repaintPending_ = false;
+    const CellPyramid& frame = frames_.Acquire();
+    double columns = static_cast<double>(frame.Width());
+    double rows = static_cast<double>(frame.Height());
+
+    // Zoomed out, the level whose cells are as large as they can be without being larger than a pixel
+    size_t level = 0;
+    while (level + 1 < frame.LevelCount() && scale_ * static_cast<double>(size_t(1) << (level + 1)) <= 1.0) {
+        ++level;
+    }
+    const Grid<float>* levelCells = level == 0 ? nullptr : &frame.Level(level);
+    double levelScale = static_cast<double>(size_t(1) << level);
+    double levelColumns = levelCells ? static_cast<double>(levelCells->Width()) : columns;
+    double levelRows = levelCells ? static_cast<double>(levelCells->Height()) : rows;
+
+    // Invert the transform used below to find which of the level's cells are on screen
+    double left = ((columns / 2.0) - ((width() / 2.0) / scale_)) / levelScale;
+    double top = ((rows / 2.0) - ((height() / 2.0) / scale_)) / levelScale;
+    double right = left + (width() / scale_ / levelScale);
+    double bottom = top + (height() / scale_ / levelScale);
+    Tile visible{
+        static_cast<size_t>(std::clamp(std::floor(left), 0.0, levelColumns)),
+        static_cast<size_t>(std::clamp(std::ceil(right), 0.0, levelColumns)),
+        static_cast<size_t>(std::clamp(std::floor(top), 0.0, levelRows)),
+        static_cast<size_t>(std::clamp(std::ceil(bottom), 0.0, levelRows)),
+    };
+    int visibleWidth = static_cast<int>(visible.lastX - visible.firstX);
+    int visibleHeight = static_cast<int>(visible.lastY - visible.firstY);
+
     QPainter p(this);
-    p.translate(0.0 + (width() / 2.0), 0.0 + (height() / 2.0));
-    p.scale(scale_, scale_);
-    p.translate(0.0 - (Rows() / 2.0), 0.0 - (Columns() / 2.0));
-    for (unsigned x = 0; x < cells.size(); x++) {
-        for (unsigned y = 0; y < cells[x].size(); y++) {
-            p.setPen(colouriser_(cells[x][y]));
-            p.drawPoint(x, y);
+    if (visibleWidth != 0 && visibleHeight != 0) {
+        if (image_.width() != visibleWidth || image_.height() != visibleHeight) {
+            image_ = QImage(visibleWidth, visibleHeight, QImage::Format_RGB32);
+        }
+        // bits() detaches the image, so must be called before the pixels are handed to other threads
+        uint32_t* pixels = reinterpret_cast<uint32_t*>(image_.bits());
+        ptrdiff_t pixelsPerLine = image_.bytesPerLine() / sizeof(uint32_t);
+        if (levelCells) {
+            renderer_.Render(*levelCells, visible, pixels, pixelsPerLine, threads_);
+        } else {
+            frame.ExportRegion(visible, visibleCells_, threads_);
+            renderer_.Render(visibleCells_, Tile{ 0, visible.lastX - visible.firstX, 0, visible.lastY - visible.firstY }, pixels, pixelsPerLine, threads_);
         }
+
+        // The last of the level's cells may cover fewer cells than the rest
+        double firstX = visible.firstX * levelScale;
+        double firstY = visible.firstY * levelScale;
+        double lastX = std::min(visible.lastX * levelScale, columns);
+        double lastY = std::min(visible.lastY * levelScale, rows);
+        p.translate(0.0 + (width() / 2.0), 0.0 + (height() / 2.0));
+        p.scale(scale_, scale_);
+        p.translate(0.0 - (columns / 2.0), 0.0 - (rows / 2.0));
+        p.drawImage(QRectF(firstX, firstY, lastX - firstX, lastY - firstY), image_);
+    }
+
+    if (showStats_) {
+        p.resetTransform();
+        PaintStats(p, frame.Width() * frame.Height());
+    }
+}
+
+void CellularAutomata::PaintStats(QPainter& p, size_t cellCount)
+{
+    Clock::time_point now = Clock::now();
+    std::chrono::duration<double> elapsed = now - statsSince_;
+    if (elapsed >= StatsInterval) {
+        uint64_t generation = frameGeneration_.load();
+        // Loading cells can take the generation backwards
+        generationsPerSecond_ = generation >= statsGeneration_ ? (generation - statsGeneration_) / elapsed.count() : 0.0;
+
+        // Counted since the pool last started its threads
+        std::vector<ThreadPool::ThreadStats> threads = threads_.Stats();
+        threadStatsText_.clear();
+        for (size_t i = 0; i < threads.size() && threads.size() == statsThreads_.size(); ++i) {
+            double busy = (threads[i].busyNanoseconds - statsThreads_[i].busyNanoseconds) * 1e-9 / elapsed.count();
+            threadStatsText_.push_back(QString("Thread %1: %2% busy, %3 tasks, %4 stolen")
+                                       .arg(static_cast<int>(i))
+                                       .arg(100.0 * busy, 0, 'f', 0)
+                                       .arg(static_cast<quint64>(threads[i].tasksRun - statsThreads_[i].tasksRun))
+                                       .arg(static_cast<quint64>(threads[i].tasksStolen - statsThreads_[i].tasksStolen)));
+        }
+        statsThreads_ = std::move(threads);
+        statsSince_ = now;
+        statsGeneration_ = generation;
+    }
+
+    std::vector<QString> lines;
+    lines.push_back(QString("Generation %1").arg(static_cast<quint64>(frameGeneration_.load())));
+    lines.push_back(QString("%1 generations/s, %2 cells/s").arg(generationsPerSecond_, 0, 'f', 1).arg(generationsPerSecond_ * cellCount, 0, 'g', 3));
+    if (Profiler::Enabled) {
+        constexpr size_t SlowestShown = 8;
+        std::vector<Profiler::Summary> summaries = Profiler::Summaries();
+        for (size_t i = 0; i < std::min(summaries.size(), SlowestShown); ++i) {
+            const Profiler::Summary& summary = summaries[i];
+            lines.push_back(QString("%1: %2 ms last, %3 ms mean")
+                            .arg(summary.name)
+                            .arg(summary.lastSeconds * 1e3, 0, 'f', 3)
+                            .arg((summary.totalSeconds / summary.count) * 1e3, 0, 'f', 3));
+        }
+        lines.insert(lines.end(), threadStatsText_.begin(), threadStatsText_.end());
+    }
+
+    QFontMetrics metrics = p.fontMetrics();
+    int lineHeight = metrics.height();
+    int textWidth = 0;
+    for (const QString& line : lines) {
+        textWidth = std::max(textWidth, metrics.horizontalAdvance(line));
+    }
+    // Legible over any colour of cell
+    p.fillRect(QRect(0, 0, textWidth + lineHeight, (static_cast<int>(lines.size()) + 1) * lineHeight), QColor(0, 0, 0, 160));
+    p.setPen(Qt::white);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        p.drawText(lineHeight / 2, (lineHeight / 2) + (static_cast<int>(i + 1) * lineHeight) - metrics.descent(), lines[i]);
     }
 }
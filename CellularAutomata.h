@@ -3,74 +3,231 @@
 
 #include "Random.h"
 #include "NeuralNetwork.h"
+#include "ThreadPool.h"
+#include "Grid.h"
+#include "Automaton.h"
+#include "HashLife.h"
+#include "Renderer.h"
+#include "CellPyramid.h"
+#include "TripleBuffer.h"
+#include "Checkpoint.h"
+#include "Pattern.h"
+#include "Profiler.h"
 
 #include <vector>
 #include <functional>
-#include <time.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 
 #include <QWidget>
+#include <QImage>
 
 class QPainter;
 
+/**
+ * Displays an Automaton, stepping it on its own thread and painting whichever
+ * generation was finished most recently. Everything that touches the cells
+ * from the GUI thread waits for the generation in progress, so a single
+ * Step() can take a while to return while the simulation is running flat out.
+ */
 class CellularAutomata : public QWidget {
     Q_OBJECT
 public:
-    using GetNeighbourFunc = std::function<const double& (int xOffset, int yOffset)>;
+    using GetNeighbourFunc = Automaton::GetNeighbourFunc;
 
     CellularAutomata(QWidget* parent, unsigned rows = 100, unsigned columns = 100);
+    ~CellularAutomata();
+
+    /**
+     * Whether the simulation thread steps on its own, one generation every
+     * interval. An interval of zero steps as fast as possible.
+     */
+    void SetRunning(bool running);
+    void SetStepInterval(std::chrono::milliseconds interval);
 
     void Step();
+    /**
+     * Starts a jump 2^log2Generations generations on, see
+     * Automaton::FastForward, made by the simulation thread a slice at a time
+     * so that it can be cancelled, replacing any jump in progress. Changing
+     * the cells or the rule cancels it too.
+     */
+    void FastForward(unsigned log2Generations);
+    void CancelJump();
+    bool Jumping() const
+    {
+        auto lock = LockState();
+        return jumping_;
+    }
     void Paint(QPainter& p) const;
 
-    size_t Rows() const { return cells.front().size(); }
-    size_t Columns() const { return cells.size(); }
-
-    const double& GetCellValue(size_t x, size_t y, int offsetX = 0, int offsetY = 0) const;
+    /**
+     * Overlays the generations and cells stepped per second, and when
+     * profiling, see Profiler, the slowest phases and how busy each thread is.
+     */
+    void SetShowStats(bool show);
+    /**
+     * Zoomed out, each pixel is drawn from a mipmap of the cells under it,
+     * see CellPyramid. Their maximum rather than their mean keeps lone cells
+     * visible however far out.
+     */
+    void SetZoomedOutMaxima(bool maxima);
+
+    size_t TilesProcessed() const;
+    size_t TileCount() const;
+
+    unsigned ThreadCount() const { return threads_.ThreadCount(); }
+    void SetThreadCount(unsigned threadCount)
+    {
+        auto lock = LockState();
+        threads_.SetThreadCount(threadCount);
+    }
 
-    void Clear(double value = 0.0);
-    void SetDimensions(size_t width, size_t height)
+    size_t Rows() const
+    {
+        auto lock = LockState();
+        return automaton_.Height();
+    }
+    size_t Columns() const
     {
-        cells.resize(height, std::vector<double>(width, 0.0));
-        nextCells.resize(height, std::vector<double>(width, 0.0));
-        for (auto& row : cells) {
-            row.resize(width, 0.0);
-        }
-        for (auto& row : nextCells) {
-            row.resize(width, 0.0);
-        }
+        auto lock = LockState();
+        return automaton_.Width();
     }
+
+    double GetCellValue(size_t x, size_t y, int offsetX = 0, int offsetY = 0) const;
+
+    void Clear(double value = 0.0);
+    void SetDimensions(size_t width, size_t height);
+    /**
+     * See Automaton::SetUnbounded.
+     */
+    void SetUnbounded(bool unbounded);
     template <typename T>
-    void Randomise(T min, T max)
+    void Randomise(T min, T max, uint64_t seed)
     {
-        Random::Seed(static_cast<unsigned long>(time(nullptr)));
-
-        for (unsigned x = 0; x < cells.size(); x++) {
-            for (unsigned y = 0; y < cells[x].size(); y++) {
-                cells[x][y] = static_cast<double>(Random::Number<T>(min, max));
-            }
-        }
-        update();
+        auto lock = LockState();
+        StopJump();
+        automaton_.Randomise(min, max, seed, threads_);
+        PublishFrame();
     }
 
+    /**
+     * See Checkpoint. setRule is handed the automaton itself, with the state
+     * already locked, so must set the rule on it directly.
+     */
+    bool SaveCheckpoint(const std::string& path, const std::string& rule, const std::string& ruleData, uint64_t seed, std::string& error);
+    std::optional<Checkpoint::Info> LoadCheckpoint(const std::string& path, const Checkpoint::RuleSetter& setRule, std::string& error);
+    /**
+     * See Pattern, the header is read by the caller so that it can set the
+     * rule first.
+     */
+    bool ReadPattern(std::istream& in, const Pattern::RleHeader& header, std::string& error);
+    bool WritePattern(std::ostream& out, const std::string& rule, bool macrocell);
+
     std::function<double (const GetNeighbourFunc& getCellValue)> GetDefaultCellStepper() const;
     std::function<unsigned(const double& value)> GetDefaultCellColouriser() const;
 
-    void SetCellStepper(std::function<double(const GetNeighbourFunc& getCellValue)>&& stepper);
+    /**
+     * See Automaton::SetCellStepper and Automaton::SetCellRule.
+     */
+    void SetCellStepper(std::function<double(const GetNeighbourFunc& getCellValue)>&& stepper, unsigned radius = 1);
+    template <typename Rule>
+    void SetCellRule(Rule rule)
+    {
+        auto lock = LockState();
+        StopJump();
+        automaton_.SetCellRule(std::move(rule));
+    }
     void SetCellColouriser(std::function<unsigned(const double& value)>&& converter);
+    /**
+     * Values from min to max are looked up from a table sampled from the
+     * converter, rather than calling it for every cell, see Renderer.
+     */
+    void SetCellColouriser(std::function<unsigned(const double& value)>&& converter, double min, double max);
+
+signals:
+    /**
+     * The running simulation has settled into a cycle, see
+     * Automaton::Period, and has paused itself. Emitted on the GUI thread.
+     */
+    void Settled(quint64 generation, quint64 period);
+    /**
+     * Emitted on the GUI thread as a jump, see FastForward, goes.
+     */
+    void JumpProgress(quint64 generationsDone, quint64 generations);
+    void JumpFinished(bool cancelled);
 
 protected:
     virtual void wheelEvent(QWheelEvent* event) override final;
     virtual void paintEvent(QPaintEvent* event) override final;
 
 private:
+    using Clock = std::chrono::steady_clock;
+
+    ThreadPool threads_;
+
+    // Guards everything below that the simulation thread touches
+    mutable std::mutex stateMutex_;
+    // The simulation thread backs off while the GUI thread is waiting for the lock
+    mutable std::atomic<unsigned> stateWaiters_ = 0;
+    mutable std::condition_variable simulationWake_;
+    std::thread simulation_;
+    bool running_ = false;
+    bool stopping_ = false;
+    std::chrono::milliseconds stepInterval_{ 200 };
+    // Stepped while the reader still had an unread frame, published before going idle
+    bool framePending_ = false;
+    // Only pauses once per cycle settled into, rather than every time it is restarted
+    bool settled_ = false;
+    // A jump in progress, stepped in slices of at most JumpSlice so that cancelling it never waits long
+    static constexpr std::chrono::milliseconds JumpSlice{ 50 };
+    bool jumping_ = false;
+    unsigned jumpLog2Generations_ = 0;
+    uint64_t jumpFrom_ = 0;
+    uint64_t jumpTo_ = 0;
+    // A jump's HashLife attempt runs without the lock, set by StopJump to abandon it
+    std::atomic<bool> jumpCancelled_ = false;
+    // Only used by the simulation thread, so needs no lock
+    HashLife hashLife_;
+    Automaton automaton_;
+
+    // Copies of the cells, and their mipmaps, handed to paintEvent, which never waits on a step
+    TripleBuffer<CellPyramid> frames_;
+    // Whether the mipmaps hold maxima rather than means
+    bool zoomedOutMaxima_ = false;
+    std::atomic<bool> repaintPending_ = false;
+    // The generation of the frame most recently published
+    std::atomic<uint64_t> frameGeneration_ = 0;
+
     double scale_ = 1.0;
     unsigned fps_ = 5;
 
-    std::vector<std::vector<double>> cells;
-    std::vector<std::vector<double>> nextCells;
-
-    std::function<double(const GetNeighbourFunc& getCellValue)> stepCell_;
-    std::function<unsigned(const double& value)> colouriser_;
+    Renderer renderer_;
+    // Reused between frames, only the visible cells are converted into them
+    Grid<double> visibleCells_{ 0, 0, 0 };
+    QImage image_;
+
+    // Rates are sampled as frames are painted, at most every StatsInterval
+    static constexpr std::chrono::milliseconds StatsInterval{ 500 };
+    bool showStats_ = false;
+    Clock::time_point statsSince_;
+    uint64_t statsGeneration_ = 0;
+    double generationsPerSecond_ = 0.0;
+    std::vector<ThreadPool::ThreadStats> statsThreads_;
+    std::vector<QString> threadStatsText_;
+
+    std::unique_lock<std::mutex> LockState() const;
+    void SimulationLoop();
+    // Callers must hold the state lock
+    void PublishFrame();
+    // Unlocks while HashLife jumps, see Automaton::BeginHashLifeJump
+    void StepJump(std::unique_lock<std::mutex>& lock);
+    void FinishJump(bool cancelled);
+    void StopJump();
+    void PaintStats(QPainter& p, size_t cellCount);
 };
 
 #endif // CELLULARAUTAMATA_H
@@ -15,22 +15,16 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(CellularAutomataCore.pri)
+
 SOURCES += \
     CellularAutomata.cpp \
-    Neighbourhood.cpp \
-    NeuralNetwork.cpp \
-    Random.cpp \
-    ThreadPool.cpp \
     main.cpp \
     MainWindow.cpp
 
 HEADERS += \
     CellularAutomata.h \
-    MainWindow.h \
-    Neighbourhood.h \
-    NeuralNetwork.h \
-    Random.h \
-    ThreadPool.h
+    MainWindow.h
 
 FORMS += \
     MainWindow.ui
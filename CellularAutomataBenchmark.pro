@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = CellularAutomataBenchmark
+
+CONFIG += console c++17 release
+CONFIG -= app_bundle qt
+
+# Kept apart from the GUI's build files when both are built in the source directory
+MAKEFILE = Makefile.benchmark
+OBJECTS_DIR = benchmark
+
+include(CellularAutomataCore.pri)
+
+SOURCES += \
+    BenchmarkMain.cpp
@@ -0,0 +1,19 @@
+TEMPLATE = app
+TARGET = CellularAutomataCli
+
+CONFIG += console c++17
+CONFIG -= app_bundle qt
+
+# Kept apart from the GUI's build files when both are built in the source directory
+MAKEFILE = Makefile.cli
+OBJECTS_DIR = cli
+
+include(CellularAutomataCore.pri)
+
+SOURCES += \
+    CliMain.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
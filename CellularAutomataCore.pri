@@ -0,0 +1,62 @@
+# The automaton itself, with no dependency on Qt, shared by the GUI and the
+# headless command line tools.
+
+CONFIG += c++17 thread
+
+# Build with CONFIG+=profile to time the phases of stepping and painting, see
+# Profiler.h, they cost nothing otherwise
+profile: DEFINES += CA_PROFILE
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/ActiveTiles.cpp \
+    $$PWD/Automaton.cpp \
+    $$PWD/BuiltInRules.cpp \
+    $$PWD/CellPyramid.cpp \
+    $$PWD/Checkpoint.cpp \
+    $$PWD/CycleDetector.cpp \
+    $$PWD/Evolution.cpp \
+    $$PWD/Fft.cpp \
+    $$PWD/HashLife.cpp \
+    $$PWD/LeniaEngine.cpp \
+    $$PWD/LifeEngine.cpp \
+    $$PWD/LifePlane.cpp \
+    $$PWD/Neighbourhood.cpp \
+    $$PWD/NeuralNetwork.cpp \
+    $$PWD/Pattern.cpp \
+    $$PWD/Profiler.cpp \
+    $$PWD/Random.cpp \
+    $$PWD/Renderer.cpp \
+    $$PWD/TableRule.cpp \
+    $$PWD/ThreadPool.cpp
+
+HEADERS += \
+    $$PWD/ActiveTiles.h \
+    $$PWD/Automaton.h \
+    $$PWD/BuiltInRules.h \
+    $$PWD/CellHash.h \
+    $$PWD/CellPyramid.h \
+    $$PWD/Checkpoint.h \
+    $$PWD/CycleDetector.h \
+    $$PWD/Evolution.h \
+    $$PWD/Fft.h \
+    $$PWD/Grid.h \
+    $$PWD/HashLife.h \
+    $$PWD/LeniaEngine.h \
+    $$PWD/LifeEngine.h \
+    $$PWD/LifePlane.h \
+    $$PWD/LifeRule.h \
+    $$PWD/Neighbourhood.h \
+    $$PWD/NeuralNetwork.h \
+    $$PWD/Pattern.h \
+    $$PWD/Philox.h \
+    $$PWD/Profiler.h \
+    $$PWD/Random.h \
+    $$PWD/Renderer.h \
+    $$PWD/Rules.h \
+    $$PWD/Stencil.h \
+    $$PWD/StencilEngine.h \
+    $$PWD/TableRule.h \
+    $$PWD/ThreadPool.h \
+    $$PWD/TripleBuffer.h
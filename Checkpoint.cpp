@@ -0,0 +1,482 @@
+#include "Checkpoint.h"
+
+#include <fstream>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CHECKPOINT_MMAP 1
+#endif
+
+static constexpr char Magic[8] = { 'C', 'A', 'C', 'H', 'E', 'C', 'K', '\0' };
+static constexpr uint32_t ByteOrderMark = 0x01020304;
+static constexpr size_t PageSize = 4096;
+static constexpr size_t LineSize = 64;
+
+enum class Compression : uint32_t {
+    None = 0,
+    PackBits = 1,
+};
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t format;
+    uint32_t compression;
+    uint64_t width;
+    uint64_t height;
+    // Bytes between rows of an uncompressed band
+    uint64_t rowBytes;
+    uint64_t bandRows;
+    uint64_t bandCount;
+    uint64_t generation;
+    uint64_t seed;
+    uint64_t ruleBytes;
+    uint64_t ruleDataBytes;
+};
+static_assert(sizeof(CheckpointHeader) == 96 && std::is_trivially_copyable_v<CheckpointHeader>, "The header is written as is, so must have no padding.");
+
+struct CheckpointBand {
+    uint64_t offset;
+    // Exactly rows * rowBytes if the band is stored uncompressed, otherwise fewer
+    uint64_t bytes;
+};
+
+static size_t RoundUp(size_t value, size_t multiple)
+{
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+/**
+ * The bytes needed for a row of width cells in format.
+ */
+static size_t CellBytes(Automaton::CellFormat format, size_t width)
+{
+    switch (format) {
+    case Automaton::CellFormat::Bits:
+        return ((width + 63) / 64) * sizeof(uint64_t);
+    case Automaton::CellFormat::UInt8:
+        return width * sizeof(uint8_t);
+    case Automaton::CellFormat::Float:
+        return width * sizeof(float);
+    case Automaton::CellFormat::Double:
+        return width * sizeof(double);
+    }
+    return 0;
+}
+
+template <typename CellType>
+static void RowToDoubles(const uint8_t* row, size_t width, double* values)
+{
+    for (size_t x = 0; x < width; ++x) {
+        CellType cell;
+        std::memcpy(&cell, row + (x * sizeof(CellType)), sizeof(CellType));
+        values[x] = static_cast<double>(cell);
+    }
+}
+
+static void RowToDoubles(Automaton::CellFormat format, const uint8_t* row, size_t width, double* values)
+{
+    switch (format) {
+    case Automaton::CellFormat::Bits:
+        for (size_t x = 0; x < width; ++x) {
+            uint64_t word;
+            std::memcpy(&word, row + ((x / 64) * sizeof(uint64_t)), sizeof(uint64_t));
+            values[x] = static_cast<double>((word >> (x % 64)) & 1);
+        }
+        break;
+    case Automaton::CellFormat::UInt8:
+        RowToDoubles<uint8_t>(row, width, values);
+        break;
+    case Automaton::CellFormat::Float:
+        RowToDoubles<float>(row, width, values);
+        break;
+    case Automaton::CellFormat::Double:
+        RowToDoubles<double>(row, width, values);
+        break;
+    }
+}
+
+/**
+ * Runs of 3 to 128 equal bytes become a count byte, 257 - length, and the
+ * byte. Anything else is copied as literals, 1 to 128 at a time after a count
+ * byte of length - 1.
+ */
+static void PackBits(const uint8_t* bytes, size_t size, std::vector<uint8_t>& packed)
+{
+    size_t index = 0;
+    while (index < size) {
+        size_t run = 1;
+        while (index + run < size && run < 128 && bytes[index + run] == bytes[index]) {
+            ++run;
+        }
+        if (run >= 3) {
+            packed.push_back(static_cast<uint8_t>(257 - run));
+            packed.push_back(bytes[index]);
+            index += run;
+            continue;
+        }
+
+        size_t first = index;
+        while (index < size && index - first < 128 && !(index + 2 < size && bytes[index] == bytes[index + 1] && bytes[index] == bytes[index + 2])) {
+            ++index;
+        }
+        packed.push_back(static_cast<uint8_t>(index - first - 1));
+        packed.insert(packed.end(), bytes + first, bytes + index);
+    }
+}
+
+/**
+ * False if packed is corrupt, or doesn't unpack to exactly size bytes.
+ */
+static bool UnpackBits(const uint8_t* packed, size_t packedSize, uint8_t* bytes, size_t size)
+{
+    size_t in = 0;
+    size_t out = 0;
+    while (in < packedSize) {
+        uint8_t count = packed[in++];
+        if (count < 128) {
+            size_t length = size_t{ count } + 1;
+            if (length > packedSize - in || length > size - out) {
+                return false;
+            }
+            std::memcpy(bytes + out, packed + in, length);
+            in += length;
+            out += length;
+        } else if (count > 128) {
+            size_t length = 257 - size_t{ count };
+            if (in == packedSize || length > size - out) {
+                return false;
+            }
+            std::memset(bytes + out, packed[in++], length);
+            out += length;
+        }
+    }
+    return out == size;
+}
+
+/**
+ * A whole file, read only. Mapped into memory where the platform allows, so
+ * pages are only read from disk as they are touched, otherwise read in.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path)
+    {
+#ifdef CHECKPOINT_MMAP
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            return;
+        }
+        struct stat status;
+        if (::fstat(descriptor, &status) == 0 && status.st_size > 0) {
+            void* mapping = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping != MAP_FAILED) {
+                data_ = static_cast<const uint8_t*>(mapping);
+                size_ = static_cast<size_t>(status.st_size);
+                // Every page will be copied out, so start reading them all now
+                ::madvise(mapping, size_, MADV_WILLNEED);
+            }
+        }
+        ::close(descriptor);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (file) {
+            contents_.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            if (file.read(reinterpret_cast<char*>(contents_.data()), static_cast<std::streamsize>(contents_.size()))) {
+                data_ = contents_.data();
+                size_ = contents_.size();
+            }
+        }
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef CHECKPOINT_MMAP
+        if (data_) {
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    const uint8_t* Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifndef CHECKPOINT_MMAP
+    std::vector<uint8_t> contents_;
+#endif
+};
+
+/**
+ * Checks everything but the contents of compressed bands, which are only
+ * checked as they are unpacked.
+ */
+static bool ReadHeader(const MappedFile& file, CheckpointHeader& header, Checkpoint::Info& info, const CheckpointBand*& bands, std::string& error)
+{
+    if (file.Size() < sizeof(CheckpointHeader)) {
+        error = "too short to be a checkpoint";
+        return false;
+    }
+    std::memcpy(&header, file.Data(), sizeof(CheckpointHeader));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+        error = "not a checkpoint";
+        return false;
+    } else if (header.byteOrder != ByteOrderMark) {
+        error = "saved on a machine with a different byte order";
+        return false;
+    } else if (header.version != Checkpoint::Version) {
+        error = "saved by version " + std::to_string(header.version) + ", only version " + std::to_string(Checkpoint::Version) + " is understood";
+        return false;
+    } else if (header.format > static_cast<uint32_t>(Automaton::CellFormat::Double) || header.compression > static_cast<uint32_t>(Compression::PackBits)) {
+        error = "unknown cell format or compression";
+        return false;
+    }
+
+    Automaton::CellFormat format = static_cast<Automaton::CellFormat>(header.format);
+    // Sizes are checked piece by piece so that none of the products can overflow
+    if (header.width > (uint64_t{ 1 } << 32) || header.height > (uint64_t{ 1 } << 32) || header.bandRows == 0 || header.bandRows > 65536
+        || header.rowBytes != RoundUp(CellBytes(format, header.width), LineSize)
+        || header.bandCount != (header.height + header.bandRows - 1) / header.bandRows
+        || header.ruleBytes > file.Size() - sizeof(CheckpointHeader)
+        || header.ruleDataBytes > file.Size() - sizeof(CheckpointHeader) - header.ruleBytes) {
+        error = "the header is corrupt";
+        return false;
+    }
+
+    size_t tableOffset = RoundUp(sizeof(CheckpointHeader) + header.ruleBytes + header.ruleDataBytes, alignof(CheckpointBand));
+    if (tableOffset > file.Size() || header.bandCount > (file.Size() - tableOffset) / sizeof(CheckpointBand)) {
+        error = "the band table is cut short";
+        return false;
+    }
+    bands = reinterpret_cast<const CheckpointBand*>(file.Data() + tableOffset);
+    for (uint64_t band = 0; band < header.bandCount; ++band) {
+        uint64_t rows = std::min(header.bandRows, header.height - (band * header.bandRows));
+        if (bands[band].offset > file.Size() || bands[band].bytes > file.Size() - bands[band].offset
+            || bands[band].bytes > rows * header.rowBytes || (header.compression == static_cast<uint32_t>(Compression::None) && bands[band].bytes != rows * header.rowBytes)) {
+            error = "band " + std::to_string(band) + " is corrupt or cut short";
+            return false;
+        }
+    }
+
+    info.rule.assign(reinterpret_cast<const char*>(file.Data() + sizeof(CheckpointHeader)), header.ruleBytes);
+    info.ruleData.assign(reinterpret_cast<const char*>(file.Data() + sizeof(CheckpointHeader) + header.ruleBytes), header.ruleDataBytes);
+    info.seed = header.seed;
+    info.generation = header.generation;
+    return true;
+}
+
+bool Checkpoint::Save(const std::string& path, const Automaton& automaton, const std::string& rule, const std::string& ruleData, uint64_t seed, bool compress, ThreadPool& threads, std::string& error)
+{
+    size_t height = automaton.Height();
+    size_t cellBytes = automaton.RowBytes();
+    size_t rowBytes = RoundUp(cellBytes, LineSize);
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.byteOrder = ByteOrderMark;
+    header.format = static_cast<uint32_t>(automaton.Format());
+    header.compression = static_cast<uint32_t>(compress ? Compression::PackBits : Compression::None);
+    header.width = automaton.Width();
+    header.height = height;
+    header.rowBytes = rowBytes;
+    header.bandRows = BandRows;
+    header.bandCount = (height + BandRows - 1) / BandRows;
+    header.generation = automaton.Generation();
+    header.seed = seed;
+    header.ruleBytes = rule.size();
+    header.ruleDataBytes = ruleData.size();
+
+    // Packed up front, so the file itself is still written front to back in one go. Bands left empty are stored uncompressed
+    std::vector<std::vector<uint8_t>> packed(compress ? header.bandCount : 0);
+    threads.ParallelFor(packed.size(), [&](size_t band)
+    {
+        size_t firstY = band * BandRows;
+        size_t rows = std::min(BandRows, height - firstY);
+        std::vector<uint8_t> bytes(rows * cellBytes);
+        for (size_t row = 0; row < rows; ++row) {
+            std::memcpy(bytes.data() + (row * cellBytes), automaton.RowData(firstY + row), cellBytes);
+        }
+        PackBits(bytes.data(), bytes.size(), packed[band]);
+        if (packed[band].size() >= rows * rowBytes) {
+            packed[band] = {};
+        }
+    });
+
+    size_t tableOffset = RoundUp(sizeof(CheckpointHeader) + rule.size() + ruleData.size(), alignof(CheckpointBand));
+    size_t offset = RoundUp(tableOffset + (header.bandCount * sizeof(CheckpointBand)), PageSize);
+    std::vector<CheckpointBand> bands(header.bandCount);
+    for (size_t band = 0; band < bands.size(); ++band) {
+        size_t rows = std::min(BandRows, height - (band * BandRows));
+        bands[band].offset = offset;
+        bands[band].bytes = compress && !packed[band].empty() ? packed[band].size() : rows * rowBytes;
+        offset = RoundUp(offset + bands[band].bytes, LineSize);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        error = "couldn't open " + path + " to write";
+        return false;
+    }
+
+    std::vector<char> padding(std::max(PageSize, rowBytes), 0);
+    size_t written = 0;
+    auto write = [&](const void* bytes, size_t size)
+    {
+        file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+        written += size;
+    };
+    auto padTo = [&](size_t position)
+    {
+        write(padding.data(), position - written);
+    };
+
+    write(&header, sizeof(header));
+    write(rule.data(), rule.size());
+    write(ruleData.data(), ruleData.size());
+    padTo(tableOffset);
+    write(bands.data(), bands.size() * sizeof(CheckpointBand));
+    for (size_t band = 0; band < bands.size() && file; ++band) {
+        padTo(bands[band].offset);
+        if (compress && !packed[band].empty()) {
+            write(packed[band].data(), packed[band].size());
+        } else {
+            size_t firstY = band * BandRows;
+            size_t rows = std::min(BandRows, height - firstY);
+            for (size_t row = 0; row < rows; ++row) {
+                write(automaton.RowData(firstY + row), cellBytes);
+                write(padding.data(), rowBytes - cellBytes);
+            }
+        }
+    }
+    file.flush();
+
+    if (!file) {
+        error = "couldn't write " + path;
+        return false;
+    }
+    return true;
+}
+
+std::optional<Checkpoint::Info> Checkpoint::ReadInfo(const std::string& path, std::string& error)
+{
+    MappedFile file(path);
+    if (!file.Data()) {
+        error = "couldn't open " + path;
+        return std::nullopt;
+    }
+
+    CheckpointHeader header;
+    Info info;
+    const CheckpointBand* bands;
+    if (!ReadHeader(file, header, info, bands, error)) {
+        error = path + ": " + error;
+        return std::nullopt;
+    }
+    return info;
+}
+
+std::optional<Checkpoint::Info> Checkpoint::Load(const std::string& path, Automaton& automaton, ThreadPool& threads, std::string& error)
+{
+    return Load(path, automaton, RuleSetter(), threads, error);
+}
+
+std::optional<Checkpoint::Info> Checkpoint::Load(const std::string& path, Automaton& automaton, const RuleSetter& setRule, ThreadPool& threads, std::string& error)
+{
+    MappedFile file(path);
+    if (!file.Data()) {
+        error = "couldn't open " + path;
+        return std::nullopt;
+    }
+
+    CheckpointHeader header;
+    Info info;
+    const CheckpointBand* bands;
+    if (!ReadHeader(file, header, info, bands, error)) {
+        error = path + ": " + error;
+        return std::nullopt;
+    }
+
+    Automaton::CellFormat format = static_cast<Automaton::CellFormat>(header.format);
+    size_t width = header.width;
+    size_t height = header.height;
+    size_t cellBytes = CellBytes(format, width);
+
+    // Compressed bands are unpacked, and so checked, before anything is written to the automaton
+    std::vector<std::vector<uint8_t>> unpacked(header.bandCount);
+    std::vector<uint8_t> corrupt(header.bandCount, false);
+    threads.ParallelFor(header.bandCount, [&](size_t band)
+    {
+        size_t firstY = band * header.bandRows;
+        size_t rows = std::min<size_t>(header.bandRows, height - firstY);
+        if (bands[band].bytes != rows * header.rowBytes) {
+            unpacked[band].resize(rows * cellBytes);
+            corrupt[band] = !UnpackBits(file.Data() + bands[band].offset, bands[band].bytes, unpacked[band].data(), unpacked[band].size());
+        }
+    });
+
+    auto firstCorrupt = std::find(corrupt.begin(), corrupt.end(), true);
+    if (firstCorrupt != corrupt.end()) {
+        error = path + ": band " + std::to_string(firstCorrupt - corrupt.begin()) + " is corrupt";
+        return std::nullopt;
+    } else if (setRule && !setRule(automaton, info, error)) {
+        error = path + ": " + error;
+        return std::nullopt;
+    }
+
+    // Cells in the current engine's format are copied straight into it, anything else goes via doubles
+    bool direct = format == automaton.Format();
+    Grid<double> converted;
+    // Getting a row to write marks the cells as changed, which isn't safe from several threads at once
+    std::vector<void*> rowData;
+    if (direct) {
+        automaton.Reset(width, height);
+        rowData.resize(height);
+        for (size_t y = 0; y < height; ++y) {
+            rowData[y] = automaton.RowData(y);
+        }
+    } else {
+        converted = Grid<double>(width, height);
+    }
+    auto readRow = [&](size_t y, const uint8_t* bytes)
+    {
+        if (direct) {
+            std::memcpy(rowData[y], bytes, cellBytes);
+        } else {
+            RowToDoubles(format, bytes, width, converted.Row(y));
+        }
+    };
+
+    threads.ParallelFor(header.bandCount, [&](size_t band)
+    {
+        size_t firstY = band * header.bandRows;
+        size_t rows = std::min<size_t>(header.bandRows, height - firstY);
+        bool packed = !unpacked[band].empty();
+        const uint8_t* bytes = packed ? unpacked[band].data() : file.Data() + bands[band].offset;
+        size_t stride = packed ? cellBytes : header.rowBytes;
+        for (size_t row = 0; row < rows; ++row) {
+            readRow(firstY + row, bytes + (row * stride));
+        }
+    });
+
+    if (!direct) {
+        automaton.SetCells(converted);
+    }
+    automaton.SetGeneration(info.generation);
+    return info;
+}
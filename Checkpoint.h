@@ -0,0 +1,75 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "Automaton.h"
+#include "ThreadPool.h"
+
+#include <string>
+#include <optional>
+#include <functional>
+#include <stdint.h>
+
+/**
+ * Saves an Automaton's cells to a binary file exactly as its engine stores
+ * them, e.g. a bit a cell for LifeRules, and restores them without parsing or
+ * converting a single cell.
+ *
+ * A file is a fixed size header, the rule's name and data, a table saying where each
+ * band of BandRows rows is stored and then, page aligned, the bands. Each row
+ * of an uncompressed band is padded to a cache line, so once the file is
+ * mapped into memory restoring it is a copy per row, a band per thread, and
+ * takes about as long as reading the file. Compressed files PackBits run
+ * length encode each band on its own, and keep any band that didn't shrink
+ * as it was.
+ *
+ * Numbers are stored in the byte order of the machine that saved them, files
+ * saved in the other order are rejected rather than swapped.
+ */
+class Checkpoint {
+public:
+    static constexpr uint32_t Version = 2;
+    static constexpr size_t BandRows = 64;
+
+    /**
+     * What is saved alongside the cells.
+     */
+    struct Info {
+        // The cells don't say what stepped them, so whatever the rule was chosen by, e.g. for SetBuiltInRule
+        std::string rule;
+        // Whatever the rule's name doesn't pin down, e.g. a neural net's weights, see SetBuiltInRule
+        std::string ruleData;
+        // What the cells were randomised from, which the cells alone don't say
+        uint64_t seed = 0;
+        uint64_t generation = 0;
+    };
+
+    /**
+     * Overwrites path in one streaming write. False, and error says why, if
+     * it couldn't.
+     */
+    static bool Save(const std::string& path, const Automaton& automaton, const std::string& rule, const std::string& ruleData, uint64_t seed, bool compress, ThreadPool& threads, std::string& error);
+    /**
+     * Only reads the header, e.g. so the saved rule can be set before Load.
+     */
+    static std::optional<Info> ReadInfo(const std::string& path, std::string& error);
+    /**
+     * Replaces the cells, dimensions and generation with those saved. Cells
+     * saved in the format the current rule stores them in are copied straight
+     * in, anything else is converted via doubles. Empty, and error says why,
+     * if the file couldn't be read, in which case the cells are left alone.
+     */
+    static std::optional<Info> Load(const std::string& path, Automaton& automaton, ThreadPool& threads, std::string& error);
+    /**
+     * Sets the saved rule, e.g. with SetBuiltInRule. False, and error says
+     * why, if it couldn't.
+     */
+    using RuleSetter = std::function<bool(Automaton& automaton, const Info& info, std::string& error)>;
+    /**
+     * As above, but setRule is called once the whole file has been checked
+     * and before any cell is replaced, so a file that can't be read leaves
+     * the rule alone as well as the cells.
+     */
+    static std::optional<Info> Load(const std::string& path, Automaton& automaton, const RuleSetter& setRule, ThreadPool& threads, std::string& error);
+};
+
+#endif // CHECKPOINT_H
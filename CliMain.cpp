@@ -0,0 +1,396 @@
+#include "Automaton.h"
+#include "BuiltInRules.h"
+#include "Checkpoint.h"
+#include "Pattern.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <optional>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+
+/*
+ * Runs an automaton without a GUI, e.g.
+ *
+ *     CellularAutomataCli --width 2000 --height 2000 --rule conway --generations 5000 --threads 8
+ *
+ * and reports how fast it was stepped.
+ */
+
+struct Options {
+    size_t width = 1000;
+    size_t height = 1000;
+    std::string rule = "conway";
+    // Otherwise a restored checkpoint's own rule is used
+    bool ruleGiven = false;
+    unsigned long long generations = 1000;
+    unsigned threads = std::thread::hardware_concurrency();
+    double randomMin = 0.0;
+    double randomMax = 1.0;
+    bool randomIntegers = true;
+    uint64_t seed = 1;
+    std::string input;
+    std::string output;
+    std::string restore;
+    std::string checkpoint;
+    bool compress = false;
+    bool unbounded = false;
+    bool settle = false;
+    bool blocked = false;
+    std::string trace;
+};
+
+static void PrintUsage(std::ostream& out)
+{
+    out << "Usage: CellularAutomataCli [options]\n"
+           "  --width N             cells across, default 1000\n"
+           "  --height N            cells down, default 1000\n"
+           "  --rule NAME           conway, conway-stencil, neuralnet, neuralnet-double, multipleneighbourhoods,\n"
+           "                        lenia, or rule notation such as B36/S23, B2/S/3 or R5,C0,M1,S34..58,B34..45,NM,\n"
+           "                        default conway\n"
+           "  --generations N       generations to step, default 1000\n"
+           "  --threads N           threads to step with, default one per core\n"
+           "  --random MIN MAX      randomise the cells with integers from MIN to MAX, default 0 1\n"
+           "  --real                randomise with real numbers rather than integers\n"
+           "  --seed N              seeds the random cells, default 1\n"
+           "  --input FILE          load the cells from a text grid, or a .rle pattern centred in the grid,\n"
+           "                        instead of randomising them. A pattern's rule is used unless --rule is given\n"
+           "  --output FILE         save the final cells as a text grid, a .rle pattern or a .mc macrocell\n"
+           "  --restore FILE        continue from a binary checkpoint, with its rule unless --rule is given\n"
+           "  --checkpoint FILE     save the final cells, rule and generation as a binary checkpoint\n"
+           "  --compress            run length encode the checkpoint\n"
+           "  --unbounded           step Life-like rules on an infinite plane rather than a torus, the grid\n"
+           "                        being the window onto it that is loaded and saved\n"
+           "  --settle              stop stepping once the cells settle into a still life or oscillator,\n"
+           "                        skipping whole periods to reach the last generation\n"
+           "  --blocked             step several generations at once while each block of cells is in cache,\n"
+           "                        rather than one at a time, the result is the same either way\n"
+           "  --trace FILE          save the stepping's timings as a Chrome trace and summarise them, only\n"
+           "                        when built with profiling, see Profiler.h\n"
+           "\n"
+           "A text grid is one row of cells per line, values separated by whitespace.\n"
+           "Patterns are in Golly's RLE and macrocell formats.\n";
+}
+
+// How many values follow an option, or -1 if it isn't one
+static int ValueCount(const std::string& option)
+{
+    if (option == "--real" || option == "--compress" || option == "--unbounded" || option == "--settle" || option == "--blocked" || option == "--help") {
+        return 0;
+    } else if (option == "--random") {
+        return 2;
+    } else if (option == "--width" || option == "--height" || option == "--rule" || option == "--generations"
+               || option == "--threads" || option == "--seed" || option == "--input" || option == "--output"
+               || option == "--restore" || option == "--checkpoint" || option == "--trace") {
+        return 1;
+    }
+    return -1;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        int valueCount = ValueCount(option);
+        if (valueCount < 0) {
+            std::cerr << "Unrecognised option " << option << "\n";
+            return false;
+        } else if (i + valueCount >= argc) {
+            std::cerr << option << " needs " << valueCount << " value(s)\n";
+            return false;
+        }
+
+        if (option == "--width") {
+            options.width = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--height") {
+            options.height = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--rule") {
+            options.rule = argv[++i];
+            options.ruleGiven = true;
+        } else if (option == "--generations") {
+            options.generations = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--threads") {
+            options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--random") {
+            options.randomMin = std::strtod(argv[++i], nullptr);
+            options.randomMax = std::strtod(argv[++i], nullptr);
+        } else if (option == "--real") {
+            options.randomIntegers = false;
+        } else if (option == "--seed") {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--input") {
+            options.input = argv[++i];
+        } else if (option == "--output") {
+            options.output = argv[++i];
+        } else if (option == "--restore") {
+            options.restore = argv[++i];
+        } else if (option == "--checkpoint") {
+            options.checkpoint = argv[++i];
+        } else if (option == "--compress") {
+            options.compress = true;
+        } else if (option == "--unbounded") {
+            options.unbounded = true;
+        } else if (option == "--settle") {
+            options.settle = true;
+        } else if (option == "--blocked") {
+            options.blocked = true;
+        } else if (option == "--trace") {
+            options.trace = argv[++i];
+        } else {
+            // --help
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool LoadGrid(const std::string& path, Grid<double>& cells)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << "\n";
+        return false;
+    }
+
+    std::vector<double> values;
+    size_t width = 0;
+    size_t height = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream row(line);
+        size_t rowWidth = 0;
+        double value;
+        while (row >> value) {
+            values.push_back(value);
+            ++rowWidth;
+        }
+        if (rowWidth == 0) {
+            continue;
+        }
+        if (height > 0 && rowWidth != width) {
+            std::cerr << path << ": row " << height + 1 << " has " << rowWidth << " cells, expected " << width << "\n";
+            return false;
+        }
+        width = rowWidth;
+        ++height;
+    }
+
+    cells = Grid<double>(width, height);
+    for (size_t y = 0; y < height; ++y) {
+        std::copy_n(values.data() + (y * width), width, cells.Row(y));
+    }
+    return true;
+}
+
+static bool EndsWith(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * The rule as other Life software would name it.
+ */
+static std::string PatternRule(const std::string& rule)
+{
+    return rule == "conway" || rule == "conway-stencil" ? "B3/S23" : rule;
+}
+
+/**
+ * The pattern's own rule is set first, unless one was given, so the cells are
+ * read straight into the engine it uses.
+ */
+static bool LoadPattern(const std::string& path, Automaton& automaton, Options& options)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << "\n";
+        return false;
+    }
+
+    std::string error;
+    Pattern::RleHeader header;
+    if (!Pattern::ReadRleHeader(file, header, error)) {
+        std::cerr << path << ": " << error << "\n";
+        return false;
+    }
+    if (!options.ruleGiven && !header.rule.empty()) {
+        options.rule = header.rule;
+        if (!SetBuiltInRule(automaton, options.rule, error)) {
+            std::cerr << path << ": " << error << "\n";
+            return false;
+        }
+    }
+    if (!Pattern::ReadRleCells(file, header, automaton, error)) {
+        std::cerr << path << ": " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool SavePattern(const std::string& path, Automaton& automaton, const std::string& rule)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << "\n";
+        return false;
+    }
+    bool saved = EndsWith(path, ".mc") ? Pattern::WriteMacrocell(file, automaton, PatternRule(rule)) : Pattern::WriteRle(file, automaton, PatternRule(rule));
+    if (!saved) {
+        std::cerr << "Couldn't write " << path << "\n";
+    }
+    return saved;
+}
+
+static bool SaveGrid(const std::string& path, const Grid<double>& cells)
+{
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << "\n";
+        return false;
+    }
+    for (size_t y = 0; y < cells.Height(); ++y) {
+        const double* row = cells.Row(y);
+        for (size_t x = 0; x < cells.Width(); ++x) {
+            file << (x == 0 ? "" : " ") << row[x];
+        }
+        file << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+static bool SaveTrace(const std::string& path, const ThreadPool& threads)
+{
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << "\n";
+        return false;
+    }
+    std::string error;
+    if (!Profiler::WriteTrace(file, error)) {
+        std::cerr << error << "\n";
+        return false;
+    }
+
+    for (const Profiler::Summary& summary : Profiler::Summaries()) {
+        std::cout << summary.name << ": " << summary.count << " in " << summary.totalSeconds << "s, "
+                  << (summary.totalSeconds / summary.count) * 1e6 << "us each\n";
+    }
+    std::vector<ThreadPool::ThreadStats> stats = threads.Stats();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        std::cout << "Thread " << i << ": " << stats[i].tasksRun << " tasks, " << stats[i].tasksStolen << " stolen, busy for "
+                  << stats[i].busyNanoseconds * 1e-9 << "s\n";
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(std::cerr);
+        return 1;
+    }
+
+    ThreadPool threads(options.threads);
+    Automaton automaton(options.width, options.height);
+    automaton.SetUnbounded(options.unbounded);
+    std::string error;
+    std::optional<Checkpoint::Info> restored;
+    // E.g. the neural net's weights, so a restored checkpoint steps on exactly as it was saved
+    std::string ruleData;
+    if (!options.restore.empty()) {
+        // The rule is set first, so that the cells can be copied straight into the engine it uses
+        restored = Checkpoint::ReadInfo(options.restore, error);
+        if (!restored) {
+            std::cerr << error << "\n";
+            return 1;
+        } else if (!options.ruleGiven) {
+            options.rule = restored->rule;
+        }
+        if (options.rule == restored->rule) {
+            ruleData = restored->ruleData;
+        }
+        options.seed = restored->seed;
+    }
+    if (!SetBuiltInRule(automaton, options.rule, ruleData, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    if (restored) {
+        auto start = std::chrono::steady_clock::now();
+        if (!Checkpoint::Load(options.restore, automaton, threads, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        std::cout << "Restored " << automaton.Width() << "x" << automaton.Height() << " cells at generation "
+                  << automaton.Generation() << " in " << seconds.count() << "s\n";
+    } else if (EndsWith(options.input, ".rle")) {
+        if (!LoadPattern(options.input, automaton, options)) {
+            return 1;
+        }
+    } else if (!options.input.empty()) {
+        Grid<double> cells;
+        if (!LoadGrid(options.input, cells)) {
+            return 1;
+        }
+        automaton.SetCells(cells);
+    } else if (options.randomIntegers) {
+        automaton.Randomise<long long>(static_cast<long long>(options.randomMin), static_cast<long long>(options.randomMax), options.seed, threads);
+    } else {
+        automaton.Randomise<double>(options.randomMin, options.randomMax, options.seed, threads);
+    }
+
+    // Only the stepping is traced
+    Profiler::Clear();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t lastGeneration = automaton.Generation() + options.generations;
+    unsigned long long stepped = 0;
+    unsigned block = options.blocked ? automaton.BlockGenerations() : 1;
+    while (automaton.Generation() < lastGeneration) {
+        if (options.settle && automaton.Period() != 0) {
+            std::cout << "Settled into a period " << automaton.Period() << " cycle by generation " << automaton.Generation() << "\n";
+            automaton.StepTo(lastGeneration, threads);
+            break;
+        }
+        uint64_t generations = std::min<uint64_t>(lastGeneration - automaton.Generation(), block);
+        automaton.Advance(generations, threads);
+        stepped += generations;
+    }
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    double cellCount = static_cast<double>(automaton.Width()) * static_cast<double>(automaton.Height());
+    std::cout << stepped << " generations of " << automaton.Width() << "x" << automaton.Height()
+              << " cells (" << options.rule << ") on " << threads.ThreadCount() << " threads in " << seconds.count() << "s\n"
+              << stepped / seconds.count() << " generations/s\n"
+              << (cellCount * stepped) / seconds.count() << " cells/s\n";
+    if (!options.trace.empty() && !SaveTrace(options.trace, threads)) {
+        return 1;
+    }
+
+    // Only converted to doubles when saved, rules that store their cells more compactly stay that way until then
+    if (EndsWith(options.output, ".rle") || EndsWith(options.output, ".mc")) {
+        if (!SavePattern(options.output, automaton, options.rule)) {
+            return 1;
+        }
+    } else if (!options.output.empty() && !SaveGrid(options.output, automaton.Cells())) {
+        return 1;
+    }
+
+    if (!options.checkpoint.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        if (!Checkpoint::Save(options.checkpoint, automaton, options.rule, ruleData, options.seed, options.compress, threads, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        std::cout << "Saved generation " << automaton.Generation() << " in " << seconds.count() << "s\n";
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "CycleDetector.h"
+
+void CycleDetector::Reset()
+{
+    hashes_.clear();
+    lastSeen_.clear();
+    candidate_ = 0;
+    matched_ = 0;
+    period_ = 0;
+}
+
+void CycleDetector::Add(uint64_t generation, uint64_t hash)
+{
+    if (hashes_.empty() || generation != lastGeneration_ + 1) {
+        Reset();
+        hashes_.assign(HistoryLength, 0);
+        firstGeneration_ = generation;
+    } else {
+        // Each generation must match the one a candidate period before it, until a whole period has
+        if (candidate_ != 0) {
+            if (HashAt(generation - candidate_) == hash) {
+                period_ = ++matched_ >= candidate_ ? candidate_ : 0;
+            } else {
+                candidate_ = 0;
+                period_ = 0;
+            }
+        }
+        if (candidate_ == 0) {
+            auto seen = lastSeen_.find(hash);
+            if (seen != lastSeen_.end()) {
+                candidate_ = generation - seen->second;
+                matched_ = 1;
+                period_ = matched_ >= candidate_ ? candidate_ : 0;
+            }
+        }
+
+        // The hash about to be overwritten drops out of the history, unless it has been seen since
+        if (generation - firstGeneration_ >= HistoryLength) {
+            auto forgotten = lastSeen_.find(HashAt(generation));
+            if (forgotten != lastSeen_.end() && forgotten->second == generation - HistoryLength) {
+                lastSeen_.erase(forgotten);
+            }
+        }
+    }
+
+    hashes_[generation % HistoryLength] = hash;
+    lastSeen_[hash] = generation;
+    lastGeneration_ = generation;
+}
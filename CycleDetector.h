@@ -0,0 +1,51 @@
+#ifndef CYCLEDETECTOR_H
+#define CYCLEDETECTOR_H
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+/**
+ * Spots when an automaton has settled into a cycle, e.g. a still life or an
+ * oscillator, from the hash of each generation in turn. The most recent
+ * HistoryLength hashes are kept, so cycles of up to that period are noticed.
+ *
+ * A repeated hash is only a candidate period, the cycle is confirmed once a
+ * whole period has repeated, so a hash collision can't end a run early.
+ */
+class CycleDetector {
+public:
+    static constexpr uint64_t HistoryLength = 1024;
+
+    /**
+     * Forgets everything, needed whenever the cells are changed other than by
+     * a step.
+     */
+    void Reset();
+    /**
+     * Generations must be added one at a time, in order, otherwise the
+     * detector starts again from this one.
+     */
+    void Add(uint64_t generation, uint64_t hash);
+
+    /**
+     * The confirmed period, 1 for a still life, or 0 if the cells haven't
+     * settled.
+     */
+    uint64_t Period() const { return period_; }
+
+private:
+    // The hash of generation g is at g % HistoryLength, once there are any
+    std::vector<uint64_t> hashes_;
+    // The most recent generation each hash in hashes_ was seen at
+    std::unordered_map<uint64_t, uint64_t> lastSeen_;
+    uint64_t firstGeneration_ = 0;
+    uint64_t lastGeneration_ = 0;
+    uint64_t candidate_ = 0;
+    uint64_t matched_ = 0;
+    uint64_t period_ = 0;
+
+    uint64_t HashAt(uint64_t generation) const { return hashes_[generation % HistoryLength]; }
+};
+
+#endif // CYCLEDETECTOR_H
@@ -0,0 +1,218 @@
+#include "Evolution.h"
+
+#include "Automaton.h"
+#include "Rules.h"
+#include "Random.h"
+#include "Philox.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <memory>
+#include <cmath>
+#include <limits>
+
+/*
+ * Every random number is keyed from the seed by Philox, the generation being
+ * the counter and what the key is for the stream.
+ */
+static uint64_t InitialCellsKey(uint64_t seed, unsigned generation)
+{
+    return Philox::Bits(seed, generation, 0);
+}
+
+static uint64_t ChildKey(uint64_t seed, unsigned generation, size_t child)
+{
+    return Philox::Bits(seed, generation, child + 1);
+}
+
+double Fitness::Activity(const Trial& trial)
+{
+    if (trial.changes.empty()) {
+        return 0.0;
+    }
+    auto secondHalf = trial.changes.begin() + (trial.changes.size() / 2);
+    return std::accumulate(secondHalf, trial.changes.end(), 0.0) / static_cast<double>(trial.changes.end() - secondHalf);
+}
+
+double Fitness::Entropy(const Trial& trial)
+{
+    constexpr size_t BinCount = 16;
+
+    std::array<size_t, BinCount> bins{};
+    const Grid<double>& cells = trial.finalCells;
+    for (size_t y = 0; y < cells.Height(); ++y) {
+        const double* row = cells.Row(y);
+        for (size_t x = 0; x < cells.Width(); ++x) {
+            double position = (std::clamp(row[x], -1.0, 1.0) + 1.0) / 2.0;
+            bins[std::min(BinCount - 1, static_cast<size_t>(position * BinCount))]++;
+        }
+    }
+
+    double count = static_cast<double>(cells.Width() * cells.Height());
+    double entropy = 0.0;
+    for (size_t binCount : bins) {
+        if (binCount > 0) {
+            double probability = static_cast<double>(binCount) / count;
+            entropy -= probability * std::log2(probability);
+        }
+    }
+    return entropy / std::log2(static_cast<double>(BinCount));
+}
+
+double Fitness::NonPeriodicity(const Trial& trial)
+{
+    if (trial.hashes.empty()) {
+        return 0.0;
+    }
+    size_t last = trial.hashes.size() - 1;
+    for (size_t earlier = last; earlier-- > 0;) {
+        if (trial.hashes[earlier] == trial.hashes[last]) {
+            return static_cast<double>(last - earlier) / static_cast<double>(trial.hashes.size());
+        }
+    }
+    return 1.0;
+}
+
+Evolution::Evolution(const Settings& settings, std::vector<Fitness::WeightedMetric>&& metrics)
+    : settings_(settings)
+    , metrics_(std::move(metrics))
+{
+    settings_.populationSize = std::max(1u, settings_.populationSize);
+    settings_.survivorCount = std::clamp(settings_.survivorCount, 1u, settings_.populationSize);
+
+    // The first generation is drawn serially, before any threads are involved
+    Random::Seed(static_cast<std::mt19937::result_type>(InitialCellsKey(settings_.seed, 0)));
+    for (unsigned candidate = 0; candidate < settings_.populationSize; ++candidate) {
+        population_.push_back({ NeuralNetwork<double>(3, 8, NeuralNetwork<double>::InitialWeights::Random), 0.0 });
+    }
+}
+
+void Evolution::Step(ThreadPool& threads)
+{
+    if (generation_ > 0) {
+        Breed(threads);
+    }
+    Evaluate(threads);
+    ++generation_;
+}
+
+void Evolution::Save(std::ostream& out) const
+{
+    std::streamsize precision = out.precision(std::numeric_limits<double>::max_digits10);
+    out << "evolution " << generation_ << " " << population_.size() << "\n";
+    for (const Candidate& candidate : population_) {
+        out << candidate.fitness << " ";
+        candidate.network.Write(out);
+    }
+    out.precision(precision);
+}
+
+bool Evolution::Load(std::istream& in)
+{
+    std::string tag;
+    unsigned generation = 0;
+    size_t count = 0;
+    if (!(in >> tag >> generation >> count) || tag != "evolution" || count == 0) {
+        return false;
+    }
+
+    std::vector<Candidate> population;
+    for (size_t candidate = 0; candidate < count; ++candidate) {
+        double fitness = 0.0;
+        if (!(in >> fitness)) {
+            return false;
+        }
+        std::optional<NeuralNetwork<double>> network = NeuralNetwork<double>::Read(in);
+        if (!network) {
+            return false;
+        }
+        population.push_back({ std::move(*network), fitness });
+    }
+
+    generation_ = generation;
+    population_ = std::move(population);
+    settings_.populationSize = static_cast<unsigned>(population_.size());
+    settings_.survivorCount = std::min(settings_.survivorCount, settings_.populationSize);
+    return true;
+}
+
+Trial Evolution::RunTrial(const NeuralNetwork<double>& network, const Grid<double>& initialCells, unsigned generations)
+{
+    // Trials are small, so they are spread across the pool rather than the tiles of each one
+    ThreadPool serial(1);
+    Automaton automaton(initialCells.Width(), initialCells.Height());
+    automaton.SetCellRule(NeuralNetRule<float>{ std::make_shared<const NeuralNetwork<float>>(network) });
+    automaton.SetCells(initialCells);
+
+    Trial trial;
+    Grid<double> previous = initialCells;
+    double cellCount = static_cast<double>(initialCells.Width() * initialCells.Height());
+    for (unsigned generation = 0; generation < generations; ++generation) {
+        automaton.Step(serial);
+        const Grid<double>& cells = automaton.Cells();
+
+        double change = 0.0;
+        for (size_t y = 0; y < cells.Height(); ++y) {
+            const double* row = cells.Row(y);
+            const double* previousRow = previous.Row(y);
+            for (size_t x = 0; x < cells.Width(); ++x) {
+                change += std::abs(row[x] - previousRow[x]);
+            }
+        }
+        trial.changes.push_back(change / cellCount);
+        // Kept up to date by the step itself
+        trial.hashes.push_back(automaton.Hash());
+        previous = cells;
+    }
+    trial.finalCells = std::move(previous);
+    return trial;
+}
+
+void Evolution::Breed(ThreadPool& threads)
+{
+    // Survivors are the front of the ranked population, children of each are dealt out in turn
+    unsigned survivors = settings_.survivorCount;
+    std::vector<std::optional<NeuralNetwork<double>>> children(settings_.populationSize - survivors);
+    threads.ParallelFor(children.size(), [&](size_t child)
+    {
+        children[child] = population_[child % survivors].network.Mutated(ChildKey(settings_.seed, generation_, child));
+    });
+
+    population_.erase(population_.begin() + survivors, population_.end());
+    for (std::optional<NeuralNetwork<double>>& child : children) {
+        population_.push_back({ std::move(*child), 0.0 });
+    }
+}
+
+void Evolution::Evaluate(ThreadPool& threads)
+{
+    Grid<double> initialCells = InitialCells();
+    threads.ParallelFor(population_.size(), [&](size_t index)
+    {
+        Candidate& candidate = population_[index];
+        Trial trial = RunTrial(candidate.network, initialCells, settings_.trialGenerations);
+        candidate.fitness = 0.0;
+        for (const Fitness::WeightedMetric& metric : metrics_) {
+            candidate.fitness += metric.weight * metric.metric(trial);
+        }
+    });
+
+    // Stable, so that ties are broken the same way whatever order the trials finished in
+    std::stable_sort(population_.begin(), population_.end(), [](const Candidate& a, const Candidate& b)
+    {
+        return a.fitness > b.fitness;
+    });
+}
+
+Grid<double> Evolution::InitialCells() const
+{
+    Grid<double> cells(settings_.gridSize, settings_.gridSize);
+    uint64_t key = InitialCellsKey(settings_.seed, generation_);
+    for (size_t y = 0; y < cells.Height(); ++y) {
+        Philox::Fill(cells.Row(y), cells.Width(), key, y * cells.Width(), -1.0, 1.0);
+    }
+    return cells;
+}
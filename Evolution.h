@@ -0,0 +1,121 @@
+#ifndef EVOLUTION_H
+#define EVOLUTION_H
+
+#include "Grid.h"
+#include "NeuralNetwork.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <functional>
+#include <iostream>
+#include <stdint.h>
+
+/**
+ * What became of one candidate's grid over a trial.
+ */
+struct Trial {
+    // Mean absolute change of a cell, for each generation stepped
+    std::vector<double> changes;
+    // A hash of the cells after each generation, equal hashes are taken to be equal states
+    std::vector<uint64_t> hashes;
+    Grid<double> finalCells;
+};
+
+/**
+ * Fitness metrics for Evolution. Each scores a trial from 0.0 upwards, higher
+ * being fitter.
+ */
+class Fitness {
+public:
+    using Metric = std::function<double(const Trial& trial)>;
+
+    struct WeightedMetric {
+        Metric metric;
+        double weight;
+    };
+
+    /**
+     * Mean absolute change of a cell per generation, over the second half of
+     * the trial so that an initial burst that dies out scores poorly.
+     */
+    static double Activity(const Trial& trial);
+    /**
+     * Shannon entropy of the final cell values, binned over [-1.0, 1.0] and
+     * scaled to [0.0, 1.0]. Uniform grids score 0.0.
+     */
+    static double Entropy(const Trial& trial);
+    /**
+     * 1.0 if the final state never occurred earlier in the trial, otherwise
+     * the length of the cycle it fell into as a fraction of the trial, so
+     * still lifes and blinkers score close to 0.0.
+     */
+    static double NonPeriodicity(const Trial& trial);
+};
+
+/**
+ * A genetic search over NeuralNetRules. Every candidate network is run on its
+ * own small grid, in parallel across the pool, and scored by a weighted sum
+ * of fitness metrics. The fittest survive unchanged into the next generation
+ * and the rest of it is filled with their mutated children.
+ *
+ * Networks are bred in double precision and evaluated as float copies, see
+ * NeuralNetwork. Every candidate in a generation starts from the same seeded
+ * grid, and every child is mutated with its own key, derived from the seed,
+ * generation and its place in the population, so runs are reproducible
+ * whatever the thread count, including when resumed from a checkpoint.
+ */
+class Evolution {
+public:
+    struct Settings {
+        unsigned populationSize = 32;
+        unsigned survivorCount = 8;
+        size_t gridSize = 64;
+        unsigned trialGenerations = 200;
+        uint64_t seed = 1;
+    };
+
+    struct Candidate {
+        NeuralNetwork<double> network;
+        // Only meaningful once the candidate has been evaluated
+        double fitness;
+    };
+
+    /**
+     * Starts from a population of random networks.
+     */
+    Evolution(const Settings& settings, std::vector<Fitness::WeightedMetric>&& metrics);
+
+    /**
+     * Breeds the next generation from the last, if there was one, then
+     * evaluates and ranks it.
+     */
+    void Step(ThreadPool& threads);
+
+    unsigned Generation() const { return generation_; }
+    /**
+     * Fittest first, after a Step().
+     */
+    const std::vector<Candidate>& Population() const { return population_; }
+
+    /**
+     * Checkpoints the ranked population as text. Loading replaces the
+     * population and generation count with those saved, the settings and
+     * metrics must be supplied as before.
+     */
+    void Save(std::ostream& out) const;
+    bool Load(std::istream& in);
+
+    static Trial RunTrial(const NeuralNetwork<double>& network, const Grid<double>& initialCells, unsigned generations);
+
+private:
+    Settings settings_;
+    std::vector<Fitness::WeightedMetric> metrics_;
+    unsigned generation_ = 0;
+    std::vector<Candidate> population_;
+
+    void Breed(ThreadPool& threads);
+    void Evaluate(ThreadPool& threads);
+    Grid<double> InitialCells() const;
+};
+
+#endif // EVOLUTION_H
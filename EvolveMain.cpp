@@ -0,0 +1,162 @@
+#include "Evolution.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <stdlib.h>
+
+/*
+ * Searches for interesting NeuralNetRules without a GUI, e.g.
+ *
+ *     CellularAutomataEvolve --generations 100 --fitness activity=1,entropy=2 --checkpoint run.txt
+ *
+ * and prints the fittest score of each generation.
+ */
+
+struct Options {
+    Evolution::Settings settings;
+    unsigned generations = 50;
+    unsigned threads = std::thread::hardware_concurrency();
+    std::string fitness = "activity=1,entropy=1,periodicity=1";
+    std::string checkpoint;
+    std::string resume;
+};
+
+static void PrintUsage(std::ostream& out)
+{
+    out << "Usage: CellularAutomataEvolve [options]\n"
+           "  --population N            candidates per generation, default 32\n"
+           "  --survivors N             fittest candidates kept each generation, default 8\n"
+           "  --grid N                  cells across and down in each trial, default 64\n"
+           "  --trial-generations N     generations each candidate is stepped for, default 200\n"
+           "  --generations N           generations to evolve for, default 50\n"
+           "  --threads N               threads to evaluate with, default one per core\n"
+           "  --seed N                  seeds the networks, trial grids and mutations, default 1\n"
+           "  --fitness NAME=WEIGHT,... weighted sum of activity, entropy and periodicity,\n"
+           "                            default activity=1,entropy=1,periodicity=1\n"
+           "  --checkpoint FILE         save the population after every generation\n"
+           "  --resume FILE             continue from a saved population\n";
+}
+
+// How many values follow an option, or -1 if it isn't one
+static int ValueCount(const std::string& option)
+{
+    if (option == "--help") {
+        return 0;
+    } else if (option == "--population" || option == "--survivors" || option == "--grid" || option == "--trial-generations"
+               || option == "--generations" || option == "--threads" || option == "--seed" || option == "--fitness"
+               || option == "--checkpoint" || option == "--resume") {
+        return 1;
+    }
+    return -1;
+}
+
+static bool ParseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        int valueCount = ValueCount(option);
+        if (valueCount < 0) {
+            std::cerr << "Unrecognised option " << option << "\n";
+            return false;
+        } else if (i + valueCount >= argc) {
+            std::cerr << option << " needs " << valueCount << " value(s)\n";
+            return false;
+        }
+
+        if (option == "--population") {
+            options.settings.populationSize = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--survivors") {
+            options.settings.survivorCount = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--grid") {
+            options.settings.gridSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--trial-generations") {
+            options.settings.trialGenerations = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--generations") {
+            options.generations = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--threads") {
+            options.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (option == "--seed") {
+            options.settings.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (option == "--fitness") {
+            options.fitness = argv[++i];
+        } else if (option == "--checkpoint") {
+            options.checkpoint = argv[++i];
+        } else if (option == "--resume") {
+            options.resume = argv[++i];
+        } else {
+            // --help
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ParseFitness(const std::string& description, std::vector<Fitness::WeightedMetric>& metrics)
+{
+    std::istringstream terms(description);
+    std::string term;
+    while (std::getline(terms, term, ',')) {
+        size_t equals = term.find('=');
+        std::string name = term.substr(0, equals);
+        double weight = equals == std::string::npos ? 1.0 : std::strtod(term.c_str() + equals + 1, nullptr);
+
+        if (name == "activity") {
+            metrics.push_back({ Fitness::Activity, weight });
+        } else if (name == "entropy") {
+            metrics.push_back({ Fitness::Entropy, weight });
+        } else if (name == "periodicity") {
+            metrics.push_back({ Fitness::NonPeriodicity, weight });
+        } else {
+            std::cerr << "Unknown fitness metric " << name << "\n";
+            return false;
+        }
+    }
+    return !metrics.empty();
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(std::cerr);
+        return 1;
+    }
+
+    std::vector<Fitness::WeightedMetric> metrics;
+    if (!ParseFitness(options.fitness, metrics)) {
+        return 1;
+    }
+
+    Evolution evolution(options.settings, std::move(metrics));
+    if (!options.resume.empty()) {
+        std::ifstream file(options.resume);
+        if (!file || !evolution.Load(file)) {
+            std::cerr << "Couldn't resume from " << options.resume << "\n";
+            return 1;
+        }
+    }
+
+    ThreadPool threads(options.threads);
+    for (unsigned step = 0; step < options.generations; ++step) {
+        auto start = std::chrono::steady_clock::now();
+        evolution.Step(threads);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        std::cout << "generation " << evolution.Generation() << " best " << evolution.Population().front().fitness
+                  << " (" << seconds.count() << "s)\n";
+
+        if (!options.checkpoint.empty()) {
+            std::ofstream file(options.checkpoint);
+            evolution.Save(file);
+            if (!file) {
+                std::cerr << "Couldn't save " << options.checkpoint << "\n";
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "Fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+// std::complex's operator* guards against infinities and NaNs, which costs a call per multiply
+static Fft::Complex Multiply(const Fft::Complex& a, const Fft::Complex& b)
+{
+    return { (a.real() * b.real()) - (a.imag() * b.imag()), (a.real() * b.imag()) + (a.imag() * b.real()) };
+}
+
+static bool IsPowerOfTwo(size_t size)
+{
+    return (size & (size - 1)) == 0;
+}
+
+Fft::Fft(size_t size)
+    : size_(size)
+    , powerOfTwo_(1)
+{
+    // Bluestein's convolution is 2n - 1 long, and must not wrap around onto itself
+    size_t needed = IsPowerOfTwo(size) ? size : (2 * size) - 1;
+    unsigned bits = 0;
+    while (powerOfTwo_ < needed) {
+        powerOfTwo_ *= 2;
+        ++bits;
+    }
+
+    twiddles_.resize(powerOfTwo_ / 2);
+    for (size_t k = 0; k < twiddles_.size(); ++k) {
+        double angle = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(powerOfTwo_);
+        twiddles_[k] = { std::cos(angle), std::sin(angle) };
+    }
+    bitReversed_.resize(powerOfTwo_);
+    for (size_t i = 0; i < powerOfTwo_; ++i) {
+        size_t reversed = 0;
+        for (unsigned bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        bitReversed_[i] = reversed;
+    }
+
+    if (!IsPowerOfTwo(size)) {
+        chirp_.resize(size);
+        for (size_t k = 0; k < size; ++k) {
+            // k^2 is periodic modulo 2n here, reducing it first keeps the angle exact for large k
+            uint64_t square = (uint64_t{ k } * k) % (2 * uint64_t{ size });
+            double angle = -M_PI * static_cast<double>(square) / static_cast<double>(size);
+            chirp_[k] = { std::cos(angle), std::sin(angle) };
+        }
+        // Both the negative and positive half of the conjugate chirp, wrapped around, the inverse's scale folded in
+        chirpSpectrum_.assign(powerOfTwo_, Complex{ 0.0, 0.0 });
+        double scale = 1.0 / static_cast<double>(powerOfTwo_);
+        for (size_t k = 0; k < size; ++k) {
+            chirpSpectrum_[k] = std::conj(chirp_[k]) * scale;
+            if (k != 0) {
+                chirpSpectrum_[powerOfTwo_ - k] = chirpSpectrum_[k];
+            }
+        }
+        PowerOfTwo(chirpSpectrum_.data());
+    }
+}
+
+void Fft::Forward(Complex* values) const
+{
+    if (IsPowerOfTwo(size_)) {
+        PowerOfTwo(values);
+    } else {
+        Bluestein(values);
+    }
+}
+
+void Fft::Inverse(Complex* values) const
+{
+    // The conjugate of the forward transform of the conjugate
+    std::transform(values, values + size_, values, [](const Complex& value) { return std::conj(value); });
+    Forward(values);
+    std::transform(values, values + size_, values, [](const Complex& value) { return std::conj(value); });
+}
+
+void Fft::PowerOfTwo(Complex* values) const
+{
+    for (size_t i = 0; i < powerOfTwo_; ++i) {
+        if (i < bitReversed_[i]) {
+            std::swap(values[i], values[bitReversed_[i]]);
+        }
+    }
+
+    for (size_t half = 1; half < powerOfTwo_; half *= 2) {
+        size_t twiddleStep = powerOfTwo_ / (2 * half);
+        for (size_t first = 0; first < powerOfTwo_; first += 2 * half) {
+            Complex* even = values + first;
+            Complex* odd = even + half;
+            for (size_t k = 0; k < half; ++k) {
+                Complex product = Multiply(odd[k], twiddles_[k * twiddleStep]);
+                odd[k] = even[k] - product;
+                even[k] += product;
+            }
+        }
+    }
+}
+
+void Fft::Bluestein(Complex* values) const
+{
+    thread_local std::vector<Complex> scratch;
+    scratch.assign(powerOfTwo_, Complex{ 0.0, 0.0 });
+    for (size_t k = 0; k < size_; ++k) {
+        scratch[k] = Multiply(values[k], chirp_[k]);
+    }
+
+    // Convolved with the conjugate chirp, by multiplying their spectra
+    PowerOfTwo(scratch.data());
+    for (size_t k = 0; k < powerOfTwo_; ++k) {
+        scratch[k] = std::conj(Multiply(scratch[k], chirpSpectrum_[k]));
+    }
+    PowerOfTwo(scratch.data());
+
+    for (size_t k = 0; k < size_; ++k) {
+        values[k] = Multiply(std::conj(scratch[k]), chirp_[k]);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * A discrete Fourier transform of one length, in O(n log n) for any length,
+ * so that a grid can be transformed at exactly its own dimensions, i.e.
+ * convolution wraps around the torus just as stepping does.
+ *
+ * Powers of two are transformed in place by an iterative radix 2 FFT. Any
+ * other length is rewritten as a convolution with a chirp (Bluestein's
+ * algorithm), which is done with a radix 2 FFT at least twice as long.
+ *
+ * Twiddles and chirps are computed once, on construction, and a transform
+ * only reads them, so one Fft can be shared by every thread.
+ */
+class Fft {
+public:
+    using Complex = std::complex<double>;
+
+    explicit Fft(size_t size = 0);
+
+    size_t Size() const { return size_; }
+
+    /**
+     * Transforms Size() values in place. Neither is scaled, so an Inverse of
+     * a Forward multiplies every value by Size().
+     */
+    void Forward(Complex* values) const;
+    void Inverse(Complex* values) const;
+
+private:
+    size_t size_;
+    // The radix 2 transform's length, size_ itself if it is a power of two
+    size_t powerOfTwo_;
+    // exp(-2 pi i k / powerOfTwo_) for the first half of k
+    std::vector<Complex> twiddles_;
+    std::vector<size_t> bitReversed_;
+
+    // Only for Bluestein's algorithm, exp(-pi i k^2 / size_) and the scaled spectrum of its conjugate
+    std::vector<Complex> chirp_;
+    std::vector<Complex> chirpSpectrum_;
+
+    void PowerOfTwo(Complex* values) const;
+    void Bluestein(Complex* values) const;
+};
+
+#endif // FFT_H
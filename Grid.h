@@ -0,0 +1,187 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <stddef.h>
+#include <assert.h>
+
+/**
+ * Minimal allocator so a std::vector's storage starts on an Alignment byte
+ * boundary.
+ */
+template <typename T, size_t Alignment>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* cells, size_t /*count*/)
+    {
+        ::operator delete(cells, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+/**
+ * A width x height array of cells stored row by row in one contiguous block.
+ * The interior is surrounded by Border() ghost cells on every side, which
+ * RefreshBorder() fills with copies of the opposite edge. Reading up to
+ * Border() cells beyond any edge therefore wraps around the torus without a
+ * modulo per access. Each interior row starts on a cache line.
+ */
+template <typename CellType>
+class Grid {
+public:
+    static constexpr size_t Alignment = 64;
+
+    Grid(size_t width = 0, size_t height = 0, size_t border = 1)
+    {
+        Reshape(width, height, border);
+    }
+
+    size_t Width() const { return width_; }
+    size_t Height() const { return height_; }
+    size_t Border() const { return border_; }
+    /**
+     * Distance in cells between vertically adjacent cells.
+     */
+    ptrdiff_t Stride() const { return static_cast<ptrdiff_t>(stride_); }
+
+    /**
+     * Points at cell (0, y). Valid for -Border() <= y < Height() + Border() and
+     * may be indexed from -Border() to Width() + Border() - 1.
+     */
+    CellType* Row(ptrdiff_t y) { return cells_.data() + origin_ + (y * Stride()); }
+    const CellType* Row(ptrdiff_t y) const { return cells_.data() + origin_ + (y * Stride()); }
+
+    CellType& At(ptrdiff_t x, ptrdiff_t y) { return Row(y)[x]; }
+    const CellType& At(ptrdiff_t x, ptrdiff_t y) const { return Row(y)[x]; }
+
+    /**
+     * Cells that exist in both the old and new size keep their values, any new
+     * cells are set to zero.
+     */
+    void Resize(size_t width, size_t height)
+    {
+        if (width != width_ || height != height_) {
+            Reshape(width, height, border_);
+        }
+    }
+
+    /**
+     * Grows or shrinks the ghost border, keeping the interior values.
+     */
+    void SetBorder(size_t border)
+    {
+        if (border != border_) {
+            Reshape(width_, height_, border);
+        }
+    }
+
+    void Fill(const CellType& value)
+    {
+        for (size_t y = 0; y < height_; ++y) {
+            std::fill_n(Row(y), width_, value);
+        }
+    }
+
+    /**
+     * Copies the interior's edges into the ghost border on the opposite side.
+     * Borders wider than the grid itself wrap around as many times as needed.
+     */
+    void RefreshBorder()
+    {
+        if (width_ == 0 || height_ == 0 || border_ == 0) {
+            return;
+        }
+
+        ptrdiff_t width = static_cast<ptrdiff_t>(width_);
+        ptrdiff_t height = static_cast<ptrdiff_t>(height_);
+        ptrdiff_t border = static_cast<ptrdiff_t>(border_);
+
+        for (ptrdiff_t y = 0; y < height; ++y) {
+            CellType* row = Row(y);
+            for (ptrdiff_t x = 1; x <= border; ++x) {
+                row[-x] = row[Wrap(-x, width)];
+                row[width - 1 + x] = row[Wrap(width - 1 + x, width)];
+            }
+        }
+        // Rows are copied including their left and right borders, filling in the corners
+        for (ptrdiff_t y = 1; y <= border; ++y) {
+            std::copy_n(Row(Wrap(-y, height)) - border, width + (2 * border), Row(-y) - border);
+            std::copy_n(Row(Wrap(height - 1 + y, height)) - border, width + (2 * border), Row(height - 1 + y) - border);
+        }
+    }
+
+    void Swap(Grid& other)
+    {
+        std::swap(cells_, other.cells_);
+        std::swap(width_, other.width_);
+        std::swap(height_, other.height_);
+        std::swap(border_, other.border_);
+        std::swap(stride_, other.stride_);
+        std::swap(origin_, other.origin_);
+    }
+
+private:
+    std::vector<CellType, AlignedAllocator<CellType, Alignment>> cells_;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    size_t border_ = 0;
+    size_t stride_ = 0;
+    size_t origin_ = 0;
+
+    static ptrdiff_t Wrap(ptrdiff_t value, ptrdiff_t size)
+    {
+        return ((value % size) + size) % size;
+    }
+
+    static size_t RoundUpToCacheLine(size_t cellCount)
+    {
+        constexpr size_t cellsPerLine = std::max<size_t>(1, Alignment / sizeof(CellType));
+        return ((cellCount + cellsPerLine - 1) / cellsPerLine) * cellsPerLine;
+    }
+
+    void Reshape(size_t width, size_t height, size_t border)
+    {
+        // Left padding is rounded up so that Row(y)[0] is aligned, not Row(y)[-border]
+        size_t leftPadding = RoundUpToCacheLine(border);
+        size_t stride = RoundUpToCacheLine(leftPadding + width + border);
+        size_t origin = (border * stride) + leftPadding;
+
+        std::vector<CellType, AlignedAllocator<CellType, Alignment>> cells(stride * (height + (2 * border)), CellType{});
+        size_t keptWidth = std::min(width, width_);
+        size_t keptHeight = std::min(height, height_);
+        for (size_t y = 0; y < keptHeight; ++y) {
+            std::copy_n(Row(y), keptWidth, cells.data() + origin + (y * stride));
+        }
+
+        cells_ = std::move(cells);
+        width_ = width;
+        height_ = height;
+        border_ = border;
+        stride_ = stride;
+        origin_ = origin;
+    }
+};
+
+#endif // GRID_H
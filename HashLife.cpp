@@ -0,0 +1,487 @@
+#include "HashLife.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <string>
+
+HashLife::HashLife(LifeRule rule, size_t nodeLimit)
+    : rule_(rule)
+    , nodeLimit_(nodeLimit)
+    , width_(0)
+    , height_(0)
+{
+    ComputeCentres();
+    Reset();
+}
+
+void HashLife::SetRule(LifeRule rule)
+{
+    if (rule != rule_) {
+        rule_ = rule;
+        ComputeCentres();
+        Reset();
+    }
+}
+
+void HashLife::Import(const Grid<double>& cells)
+{
+    Resize(cells.Width(), cells.Height());
+    for (size_t y = 0; y < height_; ++y) {
+        const double* row = cells.Row(y);
+        for (size_t x = 0; x < width_; ++x) {
+            cells_[(y * width_) + x] = row[x] != 0.0 ? 1 : 0;
+        }
+    }
+}
+
+void HashLife::Export(Grid<double>& cells) const
+{
+    assert(cells.Width() == width_ && cells.Height() == height_);
+    for (size_t y = 0; y < height_; ++y) {
+        double* row = cells.Row(y);
+        for (size_t x = 0; x < width_; ++x) {
+            row[x] = cells_[(y * width_) + x] ? 1.0 : 0.0;
+        }
+    }
+}
+
+void HashLife::Resize(size_t width, size_t height)
+{
+    // Build() packs torus coordinates into 28 bits each
+    assert(width < (size_t(1) << 28) && height < (size_t(1) << 28));
+    width_ = width;
+    height_ = height;
+    cells_.assign(width_ * height_, 0);
+}
+
+void HashLife::ImportBits(size_t y, const uint64_t* words)
+{
+    uint8_t* row = cells_.data() + (y * width_);
+    for (size_t x = 0; x < width_; ++x) {
+        row[x] = (words[x / 64] >> (x % 64)) & 1;
+    }
+}
+
+void HashLife::ExportBits(size_t y, uint64_t* words) const
+{
+    const uint8_t* row = cells_.data() + (y * width_);
+    std::fill_n(words, (width_ + 63) / 64, 0);
+    for (size_t x = 0; x < width_; ++x) {
+        words[x / 64] |= uint64_t(row[x]) << (x % 64);
+    }
+}
+
+bool HashLife::Advance(unsigned log2Generations, const std::atomic<bool>* cancel)
+{
+    PROFILE_SCOPE("HashLife advance");
+    if (width_ == 0 || height_ == 0) {
+        return true;
+    }
+    // The jump gets at least half the limit to itself, there is no root to collect from before it starts
+    if (nodes_.size() > nodeLimit_ / 2) {
+        Reset();
+    }
+
+    // The result is the centre half of the root, which must cover the whole torus
+    unsigned sizeLevel = 0;
+    while ((uint64_t(1) << sizeLevel) < std::max(width_, height_)) {
+        ++sizeLevel;
+    }
+    unsigned level = std::max({ log2Generations + 2, sizeLevel + 1, 2u });
+    assert(level < 63);
+
+    // Line the torus' origin up with the top left of the result
+    uint64_t resultOffset = uint64_t(1) << (level - 2);
+    uint64_t x = (width_ - (resultOffset % width_)) % width_;
+    uint64_t y = (height_ - (resultOffset % height_)) % height_;
+
+    abandoned_ = false;
+    cancel_ = cancel;
+    std::unordered_map<uint64_t, NodeIndex> built;
+    NodeIndex root = Build(level, x, y, built);
+    NodeIndex result = Successor(root, log2Generations);
+    cancel_ = nullptr;
+    if (abandoned_) {
+        // Every result cached was computed in full, but past the limit there are too many of them to keep
+        if (nodes_.size() > nodeLimit_) {
+            Reset();
+        }
+        return false;
+    }
+
+    std::fill(cells_.begin(), cells_.end(), 0);
+    Extract(result, 0, 0);
+
+    if (nodes_.size() > nodeLimit_ / 2) {
+        Collect(root);
+    }
+    return true;
+}
+
+void HashLife::WriteMacrocell(std::ostream& out)
+{
+    // Level 3 squares are the leaves
+    unsigned level = 3;
+    while ((uint64_t(1) << level) < std::max(width_, height_)) {
+        ++level;
+    }
+
+    NodeIndex root = BuildBounded(level, 0, 0);
+    std::unordered_map<NodeIndex, size_t> lines;
+    WriteMacrocellNode(out, root, lines);
+
+    if (nodes_.size() > nodeLimit_) {
+        Collect(root);
+    }
+}
+
+void HashLife::Reset()
+{
+    nodes_.clear();
+    nodes_.push_back({ None, None, None, None, None, 0, 0, false });
+    nodes_.push_back({ None, None, None, None, None, 0, 0, true });
+    empty_ = { Dead };
+    Rehash(size_t(1) << 16);
+}
+
+void HashLife::ComputeCentres()
+{
+    centres_.assign(1 << 16, 0);
+    for (unsigned square = 0; square < (1 << 16); ++square) {
+        auto alive = [=](int x, int y) -> bool { return (square >> ((y * 4) + x)) & 1; };
+        uint8_t centre = 0;
+        for (int y = 1; y <= 2; ++y) {
+            for (int x = 1; x <= 2; ++x) {
+                unsigned liveNeighbours = 0;
+                for (const auto& [xOffset, yOffset] : LifeRule::Coordinates) {
+                    liveNeighbours += alive(x + xOffset, y + yOffset) ? 1 : 0;
+                }
+                if (rule_.NextState(alive(x, y), liveNeighbours)) {
+                    centre |= 1 << (((y - 1) * 2) + (x - 1));
+                }
+            }
+        }
+        centres_[square] = centre;
+    }
+}
+
+HashLife::NodeIndex HashLife::Join(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se)
+{
+    size_t mask = table_.size() - 1;
+    size_t slot = Hash(nw, ne, sw, se) & mask;
+    while (table_[slot] != None) {
+        const Node& node = nodes_[table_[slot]];
+        if (node.nw == nw && node.ne == ne && node.sw == sw && node.se == se) {
+            return table_[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // Keep the table at most half full
+    if ((nodes_.size() + 1) * 2 > table_.size()) {
+        Rehash(table_.size() * 2);
+        return Join(nw, ne, sw, se);
+    }
+
+    NodeIndex index = static_cast<NodeIndex>(nodes_.size());
+    bool populated = nodes_[nw].populated || nodes_[ne].populated || nodes_[sw].populated || nodes_[se].populated;
+    nodes_.push_back({ nw, ne, sw, se, None, static_cast<uint8_t>(nodes_[nw].level + 1), 0, populated });
+    table_[slot] = index;
+    return index;
+}
+
+HashLife::NodeIndex HashLife::Empty(unsigned level)
+{
+    while (empty_.size() <= level) {
+        NodeIndex smaller = empty_.back();
+        empty_.push_back(Join(smaller, smaller, smaller, smaller));
+    }
+    return empty_[level];
+}
+
+HashLife::NodeIndex HashLife::Centre(NodeIndex node)
+{
+    Node n = nodes_[node];
+    return Join(nodes_[n.nw].se, nodes_[n.ne].sw, nodes_[n.sw].ne, nodes_[n.se].nw);
+}
+
+HashLife::NodeIndex HashLife::HorizontalCentre(NodeIndex west, NodeIndex east)
+{
+    Node w = nodes_[west];
+    Node e = nodes_[east];
+    return Join(w.ne, e.nw, w.se, e.sw);
+}
+
+HashLife::NodeIndex HashLife::VerticalCentre(NodeIndex north, NodeIndex south)
+{
+    Node n = nodes_[north];
+    Node s = nodes_[south];
+    return Join(n.sw, n.se, s.nw, s.ne);
+}
+
+HashLife::NodeIndex HashLife::Successor(NodeIndex node, unsigned step)
+{
+    // Copied, nodes_ may reallocate below
+    Node n = nodes_[node];
+    assert(n.level >= 2 && step <= n.level - 2u);
+
+    // Unwinds the jump, whatever is returned from here on is thrown away
+    abandoned_ = abandoned_ || nodes_.size() > nodeLimit_ || (cancel_ && cancel_->load(std::memory_order_relaxed));
+    if (abandoned_) {
+        return Empty(n.level - 1);
+    }
+    if (!n.populated && (rule_.birth & 1) == 0) {
+        return Empty(n.level - 1);
+    }
+    if (n.result != None && n.resultStep == step) {
+        return n.result;
+    }
+
+    NodeIndex result;
+    if (n.level == 2) {
+        result = BaseSuccessor(node);
+    } else {
+        // Nine overlapping squares of half the size
+        NodeIndex parts[9] = {
+            n.nw, HorizontalCentre(n.nw, n.ne), n.ne,
+            VerticalCentre(n.nw, n.sw), Centre(node), VerticalCentre(n.ne, n.se),
+            n.sw, HorizontalCentre(n.sw, n.se), n.se,
+        };
+        // At full speed both halves advance time, otherwise only the second does
+        bool fullSpeed = step == n.level - 2u;
+        unsigned secondStep = fullSpeed ? n.level - 3u : step;
+        for (NodeIndex& part : parts) {
+            part = fullSpeed ? Successor(part, n.level - 3u) : Centre(part);
+        }
+        result = Join(Successor(Join(parts[0], parts[1], parts[3], parts[4]), secondStep),
+                      Successor(Join(parts[1], parts[2], parts[4], parts[5]), secondStep),
+                      Successor(Join(parts[3], parts[4], parts[6], parts[7]), secondStep),
+                      Successor(Join(parts[4], parts[5], parts[7], parts[8]), secondStep));
+    }
+
+    if (!abandoned_) {
+        nodes_[node].result = result;
+        nodes_[node].resultStep = static_cast<uint8_t>(step);
+    }
+    return result;
+}
+
+HashLife::NodeIndex HashLife::BaseSuccessor(NodeIndex node)
+{
+    const Node& n = nodes_[node];
+    unsigned square = 0;
+    NodeIndex quarters[4] = { n.nw, n.ne, n.sw, n.se };
+    for (unsigned quarter = 0; quarter < 4; ++quarter) {
+        const Node& q = nodes_[quarters[quarter]];
+        unsigned x = (quarter % 2) * 2;
+        unsigned y = (quarter / 2) * 2;
+        square |= (q.nw == Alive ? 1u : 0u) << ((y * 4) + x);
+        square |= (q.ne == Alive ? 1u : 0u) << ((y * 4) + x + 1);
+        square |= (q.sw == Alive ? 1u : 0u) << (((y + 1) * 4) + x);
+        square |= (q.se == Alive ? 1u : 0u) << (((y + 1) * 4) + x + 1);
+    }
+    uint8_t centre = centres_[square];
+    auto leaf = [=](unsigned bit) { return (centre >> bit) & 1 ? Alive : Dead; };
+    return Join(leaf(0), leaf(1), leaf(2), leaf(3));
+}
+
+HashLife::NodeIndex HashLife::Build(unsigned level, uint64_t x, uint64_t y, std::unordered_map<uint64_t, NodeIndex>& built)
+{
+    if (level == 0) {
+        return cells_[(y * width_) + x] ? Alive : Dead;
+    }
+    // A cancelled jump is thrown away, but the squares built so far are real ones
+    abandoned_ = abandoned_ || (level >= 3 && cancel_ && cancel_->load(std::memory_order_relaxed));
+    if (abandoned_) {
+        return Empty(level);
+    }
+
+    // Squares start at the same torus position over and over, small ones are cheap enough to rebuild
+    uint64_t key = (uint64_t(level) << 56) | (x << 28) | y;
+    if (level >= 3) {
+        auto existing = built.find(key);
+        if (existing != built.end()) {
+            return existing->second;
+        }
+    }
+
+    uint64_t half = uint64_t(1) << (level - 1);
+    uint64_t east = (x + (half % width_)) % width_;
+    uint64_t south = (y + (half % height_)) % height_;
+    NodeIndex node = Join(Build(level - 1, x, y, built),
+                          Build(level - 1, east, y, built),
+                          Build(level - 1, x, south, built),
+                          Build(level - 1, east, south, built));
+    if (level >= 3) {
+        built[key] = node;
+    }
+    return node;
+}
+
+HashLife::NodeIndex HashLife::BuildBounded(unsigned level, uint64_t x, uint64_t y)
+{
+    if (x >= width_ || y >= height_) {
+        return Empty(level);
+    } else if (level == 0) {
+        return cells_[(y * width_) + x] ? Alive : Dead;
+    }
+
+    uint64_t half = uint64_t(1) << (level - 1);
+    return Join(BuildBounded(level - 1, x, y),
+                BuildBounded(level - 1, x + half, y),
+                BuildBounded(level - 1, x, y + half),
+                BuildBounded(level - 1, x + half, y + half));
+}
+
+bool HashLife::Get(NodeIndex node, uint64_t x, uint64_t y) const
+{
+    const Node& n = nodes_[node];
+    if (n.level == 0 || !n.populated) {
+        return n.populated;
+    }
+    uint64_t half = uint64_t(1) << (n.level - 1);
+    NodeIndex child = y < half ? (x < half ? n.nw : n.ne) : (x < half ? n.sw : n.se);
+    return Get(child, x % half, y % half);
+}
+
+size_t HashLife::WriteMacrocellNode(std::ostream& out, NodeIndex node, std::unordered_map<NodeIndex, size_t>& lines)
+{
+    if (!nodes_[node].populated) {
+        return 0;
+    }
+    auto existing = lines.find(node);
+    if (existing != lines.end()) {
+        return existing->second;
+    }
+
+    unsigned level = nodes_[node].level;
+    if (level == 3) {
+        // Rows of . and *, each ended by a $, leaving out trailing dead cells and rows
+        std::string rows;
+        std::string row;
+        for (uint64_t y = 0; y < 8; ++y) {
+            for (uint64_t x = 0; x < 8; ++x) {
+                row += Get(node, x, y) ? '*' : '.';
+            }
+            row.erase(row.find_last_not_of('.') + 1);
+            row += '$';
+            rows += row;
+            row.clear();
+        }
+        rows.erase(rows.find_last_not_of('$') + 2);
+        out << rows << '\n';
+    } else {
+        // Children first, so that every line only refers back to earlier ones
+        size_t nw = WriteMacrocellNode(out, nodes_[node].nw, lines);
+        size_t ne = WriteMacrocellNode(out, nodes_[node].ne, lines);
+        size_t sw = WriteMacrocellNode(out, nodes_[node].sw, lines);
+        size_t se = WriteMacrocellNode(out, nodes_[node].se, lines);
+        out << level << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
+    }
+
+    size_t line = lines.size() + 1;
+    lines[node] = line;
+    return line;
+}
+
+void HashLife::Extract(NodeIndex node, uint64_t x, uint64_t y)
+{
+    const Node& n = nodes_[node];
+    if (x >= width_ || y >= height_ || !n.populated) {
+        return;
+    }
+    if (n.level == 0) {
+        cells_[(y * width_) + x] = 1;
+        return;
+    }
+    uint64_t half = uint64_t(1) << (n.level - 1);
+    Extract(n.nw, x, y);
+    Extract(n.ne, x + half, y);
+    Extract(n.sw, x, y + half);
+    Extract(n.se, x + half, y + half);
+}
+
+void HashLife::Rehash(size_t capacity)
+{
+    table_.assign(capacity, None);
+    size_t mask = capacity - 1;
+    for (size_t index = 2; index < nodes_.size(); ++index) {
+        const Node& node = nodes_[index];
+        size_t slot = Hash(node.nw, node.ne, node.sw, node.se) & mask;
+        while (table_[slot] != None) {
+            slot = (slot + 1) & mask;
+        }
+        table_[slot] = static_cast<NodeIndex>(index);
+    }
+}
+
+void HashLife::Collect(NodeIndex root)
+{
+    // Keep whatever the last root reaches, and its cached results too if they fit in half the limit
+    std::vector<bool> marked;
+    auto mark = [&](bool followResults) -> size_t
+    {
+        marked.assign(nodes_.size(), false);
+        marked[Dead] = true;
+        marked[Alive] = true;
+        std::vector<NodeIndex> toVisit(empty_.begin(), empty_.end());
+        toVisit.push_back(root);
+        size_t count = 2;
+        while (!toVisit.empty()) {
+            NodeIndex index = toVisit.back();
+            toVisit.pop_back();
+            if (index == None || marked[index]) {
+                continue;
+            }
+            marked[index] = true;
+            ++count;
+            const Node& node = nodes_[index];
+            toVisit.insert(toVisit.end(), { node.nw, node.ne, node.sw, node.se });
+            if (followResults) {
+                toVisit.push_back(node.result);
+            }
+        }
+        return count;
+    };
+    if (mark(true) > nodeLimit_ / 2) {
+        mark(false);
+    }
+
+    // Children are always created before their parents, so compacting in order keeps that true
+    std::vector<NodeIndex> remap(nodes_.size(), None);
+    std::vector<Node> kept;
+    for (size_t index = 0; index < nodes_.size(); ++index) {
+        if (marked[index]) {
+            remap[index] = static_cast<NodeIndex>(kept.size());
+            kept.push_back(nodes_[index]);
+        }
+    }
+    for (size_t index = 2; index < kept.size(); ++index) {
+        Node& node = kept[index];
+        node.nw = remap[node.nw];
+        node.ne = remap[node.ne];
+        node.sw = remap[node.sw];
+        node.se = remap[node.se];
+        node.result = node.result == None ? None : remap[node.result];
+    }
+    for (NodeIndex& empty : empty_) {
+        empty = remap[empty];
+    }
+
+    nodes_ = std::move(kept);
+    size_t capacity = size_t(1) << 16;
+    while (capacity < nodes_.size() * 2) {
+        capacity *= 2;
+    }
+    Rehash(capacity);
+}
+
+size_t HashLife::Hash(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se)
+{
+    uint64_t hash = nw;
+    hash = (hash * 0x9E3779B97F4A7C15ull) ^ ne;
+    hash = (hash * 0x9E3779B97F4A7C15ull) ^ sw;
+    hash = (hash * 0x9E3779B97F4A7C15ull) ^ se;
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
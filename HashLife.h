@@ -0,0 +1,140 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include "LifeRule.h"
+#include "Grid.h"
+
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <ostream>
+#include <stdint.h>
+
+/**
+ * Gosper's HashLife for LifeRules. Space is a quadtree in which identical
+ * squares are the same node, and every node caches the centre of its square
+ * 2^j generations on, so repetition in either space or time is only ever
+ * computed once.
+ *
+ * CellularAutomata's world is a torus, so the grid is treated as one tile of
+ * an infinitely repeating plane, which evolves exactly as the torus does.
+ * Copies of the tile share nodes, which keeps the quadtree small even when a
+ * jump needs a very large area around the tile.
+ *
+ * The node count is bounded by the limit given to the constructor. A jump
+ * that would need more nodes than that is abandoned part way, and the cells
+ * are left as they were, as a torus whose sides aren't powers of two, or a
+ * chaotic pattern, can need far more nodes than there are cells. Otherwise
+ * nodes are freed by a collection at the end of Advance(), once the count
+ * has passed half the limit.
+ */
+class HashLife {
+public:
+    HashLife(LifeRule rule = LifeRule::Conway(), size_t nodeLimit = size_t(1) << 22);
+
+    /**
+     * Clears the cache, as every cached result depends on the rule.
+     */
+    void SetRule(LifeRule rule);
+    const LifeRule& GetRule() const { return rule_; }
+
+    size_t Width() const { return width_; }
+    size_t Height() const { return height_; }
+    size_t NodeCount() const { return nodes_.size(); }
+
+    /**
+     * Any non-zero cell is alive.
+     */
+    void Import(const Grid<double>& cells);
+    /**
+     * cells must have the same dimensions, live cells are set to 1.0 and dead
+     * cells to 0.0.
+     */
+    void Export(Grid<double>& cells) const;
+    /**
+     * As Import and Export a row at a time, with the cells packed as
+     * LifeEngine packs them, a bit each in 64 bit words from the lowest bit,
+     * rather than converted to doubles. Resize first to import, which leaves
+     * every cell dead.
+     */
+    void Resize(size_t width, size_t height);
+    void ImportBits(size_t y, const uint64_t* words);
+    void ExportBits(size_t y, uint64_t* words) const;
+
+    /**
+     * Moves the pattern on by 2^log2Generations generations. False, leaving
+     * the cells as they were, if that would take more nodes than the limit,
+     * or if cancel is set while it goes, e.g. from another thread.
+     */
+    bool Advance(unsigned log2Generations, const std::atomic<bool>* cancel = nullptr);
+
+    /**
+     * The node lines of Golly's macrocell format, i.e. the quadtree itself,
+     * with every distinct square written once, and the root last. The grid is
+     * padded with dead cells out to a power of two rather than repeated. The
+     * caller writes the header.
+     */
+    void WriteMacrocell(std::ostream& out);
+
+private:
+    using NodeIndex = uint32_t;
+
+    static constexpr NodeIndex None = UINT32_MAX;
+    static constexpr NodeIndex Dead = 0;
+    static constexpr NodeIndex Alive = 1;
+
+    struct Node {
+        NodeIndex nw;
+        NodeIndex ne;
+        NodeIndex sw;
+        NodeIndex se;
+        // The centre of this node after 2^resultStep generations
+        NodeIndex result;
+        uint8_t level;
+        uint8_t resultStep;
+        bool populated;
+    };
+
+    LifeRule rule_;
+    size_t nodeLimit_;
+    // Set once the jump in progress has hit the node limit or been cancelled, nothing more is computed or cached
+    bool abandoned_ = false;
+    const std::atomic<bool>* cancel_ = nullptr;
+
+    size_t width_;
+    size_t height_;
+    std::vector<uint8_t> cells_;
+
+    std::vector<Node> nodes_;
+    // Open addressing, indices into nodes_, keyed on a node's four children
+    std::vector<NodeIndex> table_;
+    // The all dead node of each level
+    std::vector<NodeIndex> empty_;
+    // Next generation of the centre 2x2 of every 4x4 square, indexed by the square's 16 bits
+    std::vector<uint8_t> centres_;
+
+    void Reset();
+    void ComputeCentres();
+
+    NodeIndex Join(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se);
+    NodeIndex Empty(unsigned level);
+    NodeIndex Centre(NodeIndex node);
+    NodeIndex HorizontalCentre(NodeIndex west, NodeIndex east);
+    NodeIndex VerticalCentre(NodeIndex north, NodeIndex south);
+    NodeIndex Successor(NodeIndex node, unsigned step);
+    NodeIndex BaseSuccessor(NodeIndex node);
+
+    NodeIndex Build(unsigned level, uint64_t x, uint64_t y, std::unordered_map<uint64_t, NodeIndex>& built);
+    // As Build, but dead outside the grid rather than wrapping
+    NodeIndex BuildBounded(unsigned level, uint64_t x, uint64_t y);
+    bool Get(NodeIndex node, uint64_t x, uint64_t y) const;
+    // Returns the node's line number, or 0 for an empty one
+    size_t WriteMacrocellNode(std::ostream& out, NodeIndex node, std::unordered_map<NodeIndex, size_t>& lines);
+    void Extract(NodeIndex node, uint64_t x, uint64_t y);
+
+    void Rehash(size_t capacity);
+    void Collect(NodeIndex root);
+    static size_t Hash(NodeIndex nw, NodeIndex ne, NodeIndex sw, NodeIndex se);
+};
+
+#endif // HASHLIFE_H
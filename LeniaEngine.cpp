@@ -0,0 +1,220 @@
+#include "LeniaEngine.h"
+
+#include "Stencil.h"
+#include "CellHash.h"
+#include "Profiler.h"
+
+#include <atomic>
+
+LeniaEngine::LeniaEngine(LeniaRule rule)
+    : rule_(std::move(rule))
+    , cells_(0, 0, 0)
+    , nextCells_(0, 0, 0)
+{
+}
+
+void LeniaEngine::SetRule(LeniaRule rule)
+{
+    rule_ = std::move(rule);
+    kernelStale_ = true;
+}
+
+void LeniaEngine::Step(ThreadPool& threads)
+{
+    size_t width = Width();
+    size_t height = Height();
+    if (width == 0 || height == 0) {
+        return;
+    }
+    RefreshKernel(threads);
+    RefreshHash(threads);
+
+    TransformRows(cells_, threads);
+    size_t columns = (width / 2) + 1;
+    threads.ParallelFor(columns, [&](size_t column)
+    {
+        PROFILE_SCOPE("Convolve column");
+        Fft::Complex* values = spectrum_.data() + (column * height);
+        const double* kernel = kernelSpectrum_.data() + (column * height);
+        columnFft_.Forward(values);
+        for (size_t y = 0; y < height; ++y) {
+            values[y] *= kernel[y];
+        }
+        columnFft_.Inverse(values);
+    });
+
+    std::atomic<uint64_t> hashChange = 0;
+    double dt = rule_.dt;
+    threads.ParallelFor((height + 1) / 2, [&](size_t pair)
+    {
+        PROFILE_SCOPE("Grow rows");
+        thread_local std::vector<Fft::Complex> row;
+        thread_local std::vector<double> potentials;
+        row.resize(width);
+        potentials.resize(width);
+
+        // Rows y and y + 1 as the real and imaginary parts of one row, the missing half of each mirroring the first
+        size_t y = 2 * pair;
+        bool second = y + 1 < height;
+        for (size_t x = 0; x < width; ++x) {
+            size_t column = x < columns ? x : width - x;
+            Fft::Complex first = spectrum_[(column * height) + y];
+            Fft::Complex next = second ? spectrum_[(column * height) + y + 1] : Fft::Complex{ 0.0, 0.0 };
+            if (x >= columns) {
+                first = std::conj(first);
+                next = std::conj(next);
+            }
+            row[x] = { first.real() - next.imag(), first.imag() + next.real() };
+        }
+        rowFft_.Inverse(row.data());
+
+        uint64_t rowsHashChange = 0;
+        for (size_t part = 0; part < (second ? 2 : 1); ++part) {
+            for (size_t x = 0; x < width; ++x) {
+                potentials[x] = part == 0 ? row[x].real() : row[x].imag();
+            }
+            // Branch free, so that it vectorises wherever the compiler has a vector exp
+            const double* cells = cells_.Row(y + part);
+            double* nextCells = nextCells_.Row(y + part);
+            for (size_t x = 0; x < width; ++x) {
+                nextCells[x] = std::clamp(cells[x] + (dt * rule_.Growth(potentials[x])), 0.0, 1.0);
+            }
+            Stencil::RowDiffers(cells, nextCells, width, (y + part) * width, rowsHashChange);
+        }
+        hashChange.fetch_xor(rowsHashChange, std::memory_order_relaxed);
+    });
+    cells_.Swap(nextCells_);
+    hash_ ^= hashChange.load();
+}
+
+void LeniaEngine::Resize(size_t width, size_t height)
+{
+    cells_ = Grid<double>(width, height, 0);
+    nextCells_ = Grid<double>(width, height, 0);
+    hashStale_ = true;
+}
+
+void LeniaEngine::Import(const Grid<double>& cells)
+{
+    cells_.Resize(cells.Width(), cells.Height());
+    nextCells_.Resize(cells.Width(), cells.Height());
+    for (size_t y = 0; y < cells.Height(); ++y) {
+        ImportRow(y, cells.Row(y));
+    }
+}
+
+void LeniaEngine::Export(Grid<double>& cells) const
+{
+    assert(cells.Width() == Width() && cells.Height() == Height());
+    for (size_t y = 0; y < Height(); ++y) {
+        ExportRow(y, cells.Row(y));
+    }
+}
+
+void LeniaEngine::ImportRow(size_t y, const double* values)
+{
+    std::copy_n(values, Width(), cells_.Row(y));
+    hashStale_ = true;
+}
+
+void LeniaEngine::ExportRow(size_t y, double* values) const
+{
+    std::copy_n(cells_.Row(y), Width(), values);
+}
+
+void LeniaEngine::TransformRows(const Grid<double>& cells, ThreadPool& threads)
+{
+    size_t width = cells.Width();
+    size_t height = cells.Height();
+    size_t columns = (width / 2) + 1;
+    threads.ParallelFor((height + 1) / 2, [&](size_t pair)
+    {
+        PROFILE_SCOPE("Transform rows");
+        thread_local std::vector<Fft::Complex> row;
+        row.resize(width);
+
+        size_t y = 2 * pair;
+        bool second = y + 1 < height;
+        const double* first = cells.Row(y);
+        const double* next = second ? cells.Row(y + 1) : nullptr;
+        for (size_t x = 0; x < width; ++x) {
+            row[x] = { first[x], next ? next[x] : 0.0 };
+        }
+        rowFft_.Forward(row.data());
+
+        // The spectrum of a real row is its own conjugate mirrored, which separates the two
+        for (size_t column = 0; column < columns; ++column) {
+            Fft::Complex value = row[column];
+            Fft::Complex mirror = std::conj(row[(width - column) % width]);
+            spectrum_[(column * height) + y] = (value + mirror) * 0.5;
+            if (second) {
+                spectrum_[(column * height) + y + 1] = (value - mirror) * Fft::Complex{ 0.0, -0.5 };
+            }
+        }
+    });
+}
+
+void LeniaEngine::RefreshKernel(ThreadPool& threads)
+{
+    size_t width = Width();
+    size_t height = Height();
+    if (rowFft_.Size() != width || columnFft_.Size() != height) {
+        rowFft_ = Fft(width);
+        columnFft_ = Fft(height);
+        spectrum_.resize(((width / 2) + 1) * height);
+        kernelSpectrum_.resize(spectrum_.size());
+        kernelStale_ = true;
+    }
+    if (!kernelStale_) {
+        return;
+    }
+    PROFILE_SCOPE("Refresh kernel");
+
+    // Centred on (0, 0), wrapping onto itself if it is wider than the grid
+    Grid<double> kernel(width, height, 0);
+    int radius = static_cast<int>(rule_.radius);
+    double total = 0.0;
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            double weight = rule_.Kernel(std::sqrt(static_cast<double>((dx * dx) + (dy * dy))) / static_cast<double>(radius));
+            size_t x = static_cast<size_t>(((dx % static_cast<int>(width)) + static_cast<int>(width)) % static_cast<int>(width));
+            size_t y = static_cast<size_t>(((dy % static_cast<int>(height)) + static_cast<int>(height)) % static_cast<int>(height));
+            kernel.At(x, y) += weight;
+            total += weight;
+        }
+    }
+
+    // Each generation's inverse transforms leave everything width * height times too large
+    double scale = total > 0.0 ? 1.0 / (total * static_cast<double>(width * height)) : 0.0;
+    TransformRows(kernel, threads);
+    threads.ParallelFor((width / 2) + 1, [&](size_t column)
+    {
+        Fft::Complex* values = spectrum_.data() + (column * height);
+        columnFft_.Forward(values);
+        for (size_t y = 0; y < height; ++y) {
+            kernelSpectrum_[(column * height) + y] = values[y].real() * scale;
+        }
+    });
+    kernelStale_ = false;
+}
+
+void LeniaEngine::RefreshHash(ThreadPool& threads)
+{
+    if (!hashStale_) {
+        return;
+    }
+    PROFILE_SCOPE("Refresh hash");
+    std::atomic<uint64_t> hash = 0;
+    size_t width = Width();
+    threads.ParallelFor(Height(), [&](size_t y)
+    {
+        const double* row = cells_.Row(y);
+        uint64_t rowHash = 0;
+        for (size_t x = 0; x < width; ++x) {
+            rowHash ^= CellHash::Of((y * width) + x, CellHash::Bits(row[x]));
+        }
+        hash.fetch_xor(rowHash, std::memory_order_relaxed);
+    });
+    hash_ = hash.load();
+    hashStale_ = false;
+}
@@ -0,0 +1,176 @@
+#ifndef LENIAENGINE_H
+#define LENIAENGINE_H
+
+#include "Grid.h"
+#include "Fft.h"
+#include "ThreadPool.h"
+#include "Philox.h"
+#include "Stencil.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+/**
+ * A continuous Lenia style rule, cells from 0 to 1. Each generation a cell
+ * moves dt of the way along the growth function of its potential, which is
+ * the weighted sum of the cells within radius of it.
+ *
+ * The kernel's weights are concentric rings, a smooth bump each from one
+ * ring's edge to the next, whose heights are peaks from the centre out. The
+ * kernel is normalised so that its weights sum to 1.
+ */
+struct LeniaRule {
+    // In cells, the kernel reaches radius - 1 cells out
+    unsigned radius = 13;
+    std::vector<double> peaks{ 1.0 };
+    // Growth is 1 at a potential of mu, falling to -1 either side of it over a few sigma
+    double mu = 0.15;
+    double sigma = 0.015;
+    double dt = 0.1;
+
+    /**
+     * Bert Chan's Orbium, a glider, given a suitable starting blob.
+     */
+    static LeniaRule Orbium() { return LeniaRule{}; }
+
+    /**
+     * The kernel's weight at distance radii from the centre, before it is
+     * normalised.
+     */
+    double Kernel(double distance) const
+    {
+        if (distance <= 0.0 || distance >= 1.0 || peaks.empty()) {
+            return 0.0;
+        }
+        double rings = distance * static_cast<double>(peaks.size());
+        size_t ring = std::min(static_cast<size_t>(rings), peaks.size() - 1);
+        double fraction = rings - static_cast<double>(ring);
+        return fraction <= 0.0 || fraction >= 1.0 ? 0.0 : peaks[ring] * std::exp(4.0 - (1.0 / (fraction * (1.0 - fraction))));
+    }
+
+    double Growth(double potential) const
+    {
+        double deviation = (potential - mu) / sigma;
+        return (2.0 * std::exp(-0.5 * deviation * deviation)) - 1.0;
+    }
+};
+
+/**
+ * Steps a LeniaRule, whose kernel is far too wide to sum cell by cell as
+ * StencilEngine does, e.g. 529 weights a cell for the radius 13 Orbium.
+ *
+ * Instead the potential of every cell is the convolution of the cells with
+ * the kernel, which is a multiplication of their spectra. Each generation is
+ * a forward 2D FFT of the cells, a multiply by the kernel's spectrum and an
+ * inverse FFT, O(N log N) for N cells whatever the radius. The kernel's
+ * spectrum is only recomputed when the rule or the dimensions change. The
+ * transforms are exactly the grid's dimensions, see Fft, so the kernel wraps
+ * around the torus just as a stencil would.
+ *
+ * The cells are real, so two rows are transformed at once as the real and
+ * imaginary parts of one, and only the columns of the first half of the
+ * spectrum are transformed, the rest mirroring them.
+ *
+ * Every cell is recomputed every generation, as one tile. A CellHash of the
+ * cells is kept up to date as StencilEngine's is.
+ */
+class LeniaEngine {
+public:
+    LeniaEngine(LeniaRule rule = LeniaRule::Orbium());
+
+    size_t Width() const { return cells_.Width(); }
+    size_t Height() const { return cells_.Height(); }
+
+    const Grid<double>& Cells() const { return cells_; }
+
+    void SetRule(LeniaRule rule);
+    const LeniaRule& GetRule() const { return rule_; }
+
+    void Step(ThreadPool& threads);
+    /**
+     * See CellHash, only up to date once stepped since the cells were last
+     * written to from outside.
+     */
+    uint64_t Hash() const { return hash_; }
+
+    size_t TilesProcessed() const { return 1; }
+    size_t TileCount() const { return 1; }
+    template <typename Visitor>
+    void ForEachChangedTile(Visitor&& visitor) const
+    {
+        visitor(Tile{ 0, Width(), 0, Height() });
+    }
+
+    double Get(size_t x, size_t y) const { return cells_.Row(y)[x]; }
+
+    /**
+     * Every cell is set to zero.
+     */
+    void Resize(size_t width, size_t height);
+    /**
+     * Resizes to match cells.
+     */
+    void Import(const Grid<double>& cells);
+    /**
+     * cells must have the same dimensions.
+     */
+    void Export(Grid<double>& cells) const;
+    /**
+     * Width() values at a time, for filling in the cells after Resize().
+     */
+    void ImportRow(size_t y, const double* values);
+    void ExportRow(size_t y, double* values) const;
+    /**
+     * Row y as stored, RowBytes() bytes of doubles, as ImportRow.
+     */
+    size_t RowBytes() const { return Width() * sizeof(double); }
+    const void* RowData(size_t y) const { return cells_.Row(y); }
+    void* RowData(size_t y) { hashStale_ = true; return cells_.Row(y); }
+
+    /**
+     * Each cell's value depends only on the seed and its position.
+     */
+    template <typename T>
+    void Randomise(T min, T max, uint64_t seed, ThreadPool& threads)
+    {
+        size_t width = cells_.Width();
+        threads.ParallelFor(cells_.Height(), [&](size_t y)
+        {
+            double* row = cells_.Row(y);
+            for (size_t x = 0; x < width; ++x) {
+                row[x] = static_cast<double>(Philox::Number(seed, (y * width) + x, min, max));
+            }
+        });
+        hashStale_ = true;
+    }
+
+private:
+    LeniaRule rule_;
+    Grid<double> cells_;
+    Grid<double> nextCells_;
+    uint64_t hash_ = 0;
+    bool hashStale_ = true;
+
+    Fft rowFft_;
+    Fft columnFft_;
+    // Columns 0 to Width() / 2 of the 2D spectrum, a column at a time
+    std::vector<Fft::Complex> spectrum_;
+    // Laid out as spectrum_, real as the kernel is symmetric, and scaled to undo both inverse transforms
+    std::vector<double> kernelSpectrum_;
+    bool kernelStale_ = true;
+
+    /**
+     * Fills spectrum_ with the row by row transform of cells.
+     */
+    void TransformRows(const Grid<double>& cells, ThreadPool& threads);
+    /**
+     * Recomputes the kernel's spectrum, and the transforms, if the rule or
+     * dimensions changed since.
+     */
+    void RefreshKernel(ThreadPool& threads);
+    void RefreshHash(ThreadPool& threads);
+};
+
+#endif // LENIAENGINE_H
@@ -0,0 +1,188 @@
+#include "LifeEngine.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+
+LifeWordStepper::LifeWordStepper(const LifeRule& rule)
+    : rule_(rule)
+    , countCount_(0)
+{
+    for (unsigned count = 0; count <= 8; ++count) {
+        if (((rule_.birth | rule_.survival) >> count) & 1) {
+            counts_[countCount_++] = count;
+        }
+    }
+}
+
+LifeEngine::LifeEngine(LifeRule rule)
+    : rule_(rule)
+    , width_(0)
+    , height_(0)
+    , wordsPerRow_(0)
+    , stride_(2)
+{
+}
+
+void LifeEngine::Import(const Grid<double>& cells)
+{
+    Resize(cells.Width(), cells.Height());
+    for (size_t y = 0; y < height_; ++y) {
+        ImportRow(y, cells.Row(y));
+    }
+}
+
+void LifeEngine::Export(Grid<double>& cells) const
+{
+    assert(cells.Width() == width_ && cells.Height() == height_);
+    for (size_t y = 0; y < height_; ++y) {
+        ExportRow(y, cells.Row(y));
+    }
+}
+
+void LifeEngine::ImportRow(size_t y, const double* values)
+{
+    uint64_t* words = Row(cells_, y);
+    std::fill_n(words, wordsPerRow_, 0);
+    for (size_t x = 0; x < width_; ++x) {
+        words[x / 64] |= uint64_t(values[x] != 0.0 ? 1 : 0) << (x % 64);
+    }
+    hashStale_ = true;
+}
+
+void LifeEngine::ExportRow(size_t y, double* values) const
+{
+    const uint64_t* words = Row(cells_, y);
+    for (size_t x = 0; x < width_; ++x) {
+        values[x] = (words[x / 64] >> (x % 64)) & 1 ? 1.0 : 0.0;
+    }
+}
+
+void LifeEngine::Step(ThreadPool& threads)
+{
+    if (width_ == 0 || height_ == 0) {
+        return;
+    }
+
+    size_t bandCount = (height_ + BandHeight - 1) / BandHeight;
+    // Every row's guards must be in place before any row reads its neighbours'
+    threads.ParallelFor(bandCount, [&](size_t band)
+    {
+        PROFILE_SCOPE("Refresh guards");
+        for (size_t y = band * BandHeight; y < std::min(height_, (band + 1) * BandHeight); ++y) {
+            RefreshGuards(y);
+        }
+    });
+    RefreshHash(threads);
+    // A tile's neighbours are always within one tile of it
+    const std::vector<size_t>& tiles = activeTiles_.Schedule(1);
+    std::atomic<uint64_t> hashChange = 0;
+    threads.ParallelFor(tiles.size(), [&](size_t index)
+    {
+        PROFILE_SCOPE("Step tile");
+        size_t tile = tiles[index];
+        size_t firstWord = (tile % activeTiles_.Columns()) * TileWords;
+        size_t lastWord = std::min(wordsPerRow_, firstWord + TileWords);
+        size_t firstY = (tile / activeTiles_.Columns()) * BandHeight;
+        bool changed = false;
+        uint64_t tileHashChange = 0;
+        for (size_t y = firstY; y < std::min(height_, firstY + BandHeight); ++y) {
+            changed |= StepRow(y, firstWord, lastWord, tileHashChange);
+        }
+        if (changed) {
+            activeTiles_.SetChanged(tile);
+            hashChange.fetch_xor(tileHashChange, std::memory_order_relaxed);
+        }
+    });
+    activeTiles_.Finish();
+    std::swap(cells_, nextCells_);
+    hash_ ^= hashChange.load();
+}
+
+void LifeEngine::Resize(size_t width, size_t height)
+{
+    width_ = width;
+    height_ = height;
+    wordsPerRow_ = (width + 63) / 64;
+    stride_ = wordsPerRow_ + 2;
+    cells_.assign(stride_ * height_, 0);
+    nextCells_.assign(stride_ * height_, 0);
+    activeTiles_.Resize((wordsPerRow_ + TileWords - 1) / TileWords, (height_ + BandHeight - 1) / BandHeight);
+    hashStale_ = true;
+}
+
+void LifeEngine::RefreshGuards(size_t y)
+{
+    uint64_t* words = Row(cells_, y);
+    size_t last = wordsPerRow_ - 1;
+    size_t bitsInLastWord = width_ - (64 * last);
+
+    uint64_t firstCell = words[0] & 1;
+    uint64_t lastCell = (words[last] >> (bitsInLastWord - 1)) & 1;
+
+    // The west neighbour of cell 0 is the top bit of the left guard
+    words[-1] = lastCell << 63;
+    if (bitsInLastWord < 64) {
+        // The east neighbour of the last cell is the first unused bit of the last word
+        words[last] &= (uint64_t(1) << bitsInLastWord) - 1;
+        words[last] |= firstCell << bitsInLastWord;
+        words[last + 1] = 0;
+    } else {
+        words[last + 1] = firstCell;
+    }
+}
+
+void LifeEngine::RefreshHash(ThreadPool& threads)
+{
+    if (!hashStale_) {
+        return;
+    }
+    PROFILE_SCOPE("Refresh hash");
+    // The bits past the end of each row may hold a guard, which isn't part of the hash
+    size_t bitsInLastWord = width_ - (64 * (wordsPerRow_ - 1));
+    uint64_t lastWordMask = bitsInLastWord < 64 ? (uint64_t(1) << bitsInLastWord) - 1 : ~uint64_t(0);
+    std::atomic<uint64_t> hash = 0;
+    threads.ParallelFor(height_, [&](size_t y)
+    {
+        const uint64_t* words = Row(cells_, y);
+        uint64_t rowHash = 0;
+        for (size_t i = 0; i < wordsPerRow_; ++i) {
+            rowHash ^= CellHash::Of((y * wordsPerRow_) + i, i + 1 == wordsPerRow_ ? words[i] & lastWordMask : words[i]);
+        }
+        hash.fetch_xor(rowHash, std::memory_order_relaxed);
+    });
+    hash_ = hash.load();
+    hashStale_ = false;
+}
+
+bool LifeEngine::StepRow(size_t y, size_t firstWord, size_t lastWord, uint64_t& hashChange)
+{
+    const uint64_t* above = Row(cells_, (y + height_ - 1) % height_);
+    const uint64_t* row = Row(cells_, y);
+    const uint64_t* below = Row(cells_, (y + 1) % height_);
+    uint64_t* next = Row(nextCells_, y);
+
+    LifeWordStepper stepper(rule_);
+    for (size_t i = firstWord; i < lastWord; ++i) {
+        next[i] = stepper.Next(above + i, row + i, below + i);
+    }
+
+    // Keep the bits past the end of the row clear, they hold a guard in cells_ so are left out of the comparison
+    size_t bitsInLastWord = width_ - (64 * (wordsPerRow_ - 1));
+    if (lastWord == wordsPerRow_ && bitsInLastWord < 64) {
+        next[wordsPerRow_ - 1] &= (uint64_t(1) << bitsInLastWord) - 1;
+    }
+
+    uint64_t differences = 0;
+    for (size_t i = firstWord; i < lastWord; ++i) {
+        uint64_t validBits = (i == wordsPerRow_ - 1 && bitsInLastWord < 64) ? (uint64_t(1) << bitsInLastWord) - 1 : ~uint64_t(0);
+        uint64_t difference = (next[i] ^ row[i]) & validBits;
+        if (difference != 0) {
+            uint64_t position = (y * wordsPerRow_) + i;
+            hashChange ^= CellHash::Of(position, row[i] & validBits) ^ CellHash::Of(position, next[i]);
+        }
+        differences |= difference;
+    }
+    return differences != 0;
+}
@@ -0,0 +1,231 @@
+#ifndef LIFEENGINE_H
+#define LIFEENGINE_H
+
+#include "LifeRule.h"
+#include "Grid.h"
+#include "ThreadPool.h"
+#include "ActiveTiles.h"
+#include "Philox.h"
+#include "CellHash.h"
+#include "Stencil.h"
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+/**
+ * A LifeRule applied to 64 cells at once, a bit each. All 64 cells have their
+ * neighbours counted at once, bit-sliced through a tree of full adders, so a
+ * word costs a handful of logic ops rather than eight reads per cell.
+ */
+class LifeWordStepper {
+public:
+    explicit LifeWordStepper(const LifeRule& rule);
+
+    /**
+     * The next generation of the word at row[0], above[0] and below[0] being
+     * the words of the rows either side of it. Each is read along with the
+     * words either side of it, i.e. [-1] and [1], for the neighbours of its
+     * first and last cells.
+     */
+    uint64_t Next(const uint64_t* above, const uint64_t* row, const uint64_t* below) const
+    {
+        uint64_t neighbours[8] = {
+            (above[0] << 1) | (above[-1] >> 63),
+            above[0],
+            (above[0] >> 1) | (above[1] << 63),
+            (row[0] << 1) | (row[-1] >> 63),
+            (row[0] >> 1) | (row[1] << 63),
+            (below[0] << 1) | (below[-1] >> 63),
+            below[0],
+            (below[0] >> 1) | (below[1] << 63),
+        };
+
+        // Sum the eight neighbour bits into a 4 bit count, ones + 2 * twos + 4 * fours + 8 * eights
+        uint64_t sumA, carryA, sumB, carryB, sumC, carryC;
+        FullAdder(neighbours[0], neighbours[1], neighbours[2], sumA, carryA);
+        FullAdder(neighbours[3], neighbours[4], neighbours[5], sumB, carryB);
+        HalfAdder(neighbours[6], neighbours[7], sumC, carryC);
+
+        uint64_t ones, carryD;
+        FullAdder(sumA, sumB, sumC, ones, carryD);
+
+        uint64_t twosPartial, foursA, twos, foursB;
+        FullAdder(carryA, carryB, carryC, twosPartial, foursA);
+        HalfAdder(twosPartial, carryD, twos, foursB);
+
+        uint64_t fours, eights;
+        HalfAdder(foursA, foursB, fours, eights);
+
+        uint64_t born = 0;
+        uint64_t survives = 0;
+        for (unsigned c = 0; c < countCount_; ++c) {
+            unsigned count = counts_[c];
+            uint64_t matches = (count & 1 ? ones : ~ones)
+                             & (count & 2 ? twos : ~twos)
+                             & (count & 4 ? fours : ~fours)
+                             & (count & 8 ? eights : ~eights);
+            born |= ((rule_.birth >> count) & 1) ? matches : 0;
+            survives |= ((rule_.survival >> count) & 1) ? matches : 0;
+        }
+
+        return (row[0] & survives) | (~row[0] & born);
+    }
+
+private:
+    LifeRule rule_;
+    // Only the counts the rule cares about are matched, most rules only have a few
+    unsigned counts_[9];
+    unsigned countCount_;
+
+    // Bit-sliced adders, each bit position is an independent cell
+
+    static void HalfAdder(uint64_t a, uint64_t b, uint64_t& sum, uint64_t& carry)
+    {
+        sum = a ^ b;
+        carry = a & b;
+    }
+
+    static void FullAdder(uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry)
+    {
+        uint64_t partial = a ^ b;
+        sum = partial ^ c;
+        carry = (a & b) | (partial & c);
+    }
+};
+
+/**
+ * Steps a LifeRule on a torus of single bit cells, 64 to a word, with
+ * LifeWordStepper. Words within a row don't depend on each other, so the
+ * compiler is free to widen the loop further with SIMD.
+ *
+ * Each row is stored with a guard word either side, and the spare bits past
+ * the end of the row's last word double as a guard. Before each generation
+ * the guards are refreshed with the cells from the opposite edge.
+ *
+ * Rows are split into tiles of TileWords words, and only tiles next to one
+ * that changed last generation are recomputed. A CellHash of the cells, a
+ * word at a time, is kept up to date from the words each step changed.
+ */
+class LifeEngine {
+public:
+    LifeEngine(LifeRule rule = LifeRule::Conway());
+
+    size_t Width() const { return width_; }
+    size_t Height() const { return height_; }
+
+    void SetRule(LifeRule rule) { rule_ = rule; activeTiles_.MarkAllChanged(); }
+    const LifeRule& GetRule() const { return rule_; }
+    /**
+     * Needed after writing rows, once anything has been stepped since Resize().
+     */
+    void MarkAllChanged() { activeTiles_.MarkAllChanged(); }
+
+    /**
+     * Resizes to match cells, any non-zero cell is alive.
+     */
+    void Import(const Grid<double>& cells);
+    /**
+     * cells must have the same dimensions, live cells are set to 1.0 and dead
+     * cells to 0.0.
+     */
+    void Export(Grid<double>& cells) const;
+    /**
+     * Every cell is dead.
+     */
+    void Resize(size_t width, size_t height);
+    /**
+     * Width() values at a time, as Import and Export. Importing a row doesn't
+     * mark anything as changed, it is for filling in the cells after Resize().
+     */
+    void ImportRow(size_t y, const double* values);
+    void ExportRow(size_t y, double* values) const;
+    /**
+     * Row y as stored, RowBytes() bytes of 64 cell words, for copying cells in
+     * and out without conversion. Writing doesn't mark anything as changed,
+     * as ImportRow.
+     */
+    size_t RowBytes() const { return wordsPerRow_ * sizeof(uint64_t); }
+    const void* RowData(size_t y) const { return Row(cells_, y); }
+    void* RowData(size_t y) { hashStale_ = true; return Row(cells_, y); }
+
+    bool Get(size_t x, size_t y) const { return (Row(cells_, y)[x / 64] >> (x % 64)) & 1; }
+
+    /**
+     * Cells are alive where the same seed would give a grid of doubles a
+     * non-zero value, see Automaton::Randomise.
+     */
+    template <typename T>
+    void Randomise(T min, T max, uint64_t seed, ThreadPool& threads)
+    {
+        threads.ParallelFor(height_, [&](size_t y)
+        {
+            uint64_t* words = Row(cells_, y);
+            std::fill_n(words, wordsPerRow_, 0);
+            for (size_t x = 0; x < width_; ++x) {
+                words[x / 64] |= uint64_t(Philox::Number(seed, (y * width_) + x, min, max) != T{ 0 } ? 1 : 0) << (x % 64);
+            }
+        });
+        activeTiles_.MarkAllChanged();
+        hashStale_ = true;
+    }
+
+    void Step(ThreadPool& threads);
+    /**
+     * See CellHash, the position of a word being y * words per row + its
+     * index. Only up to date once stepped since the cells were last written to
+     * from outside.
+     */
+    uint64_t Hash() const { return hash_; }
+
+    size_t TilesProcessed() const { return activeTiles_.ProcessedCount(); }
+    size_t TileCount() const { return activeTiles_.Count(); }
+    /**
+     * Calls visitor with the cells of each tile that changed in the last
+     * Step(), see ActiveTiles::Changed.
+     */
+    template <typename Visitor>
+    void ForEachChangedTile(Visitor&& visitor) const
+    {
+        size_t columns = activeTiles_.Columns();
+        for (size_t tile = 0; tile < activeTiles_.Count(); ++tile) {
+            if (activeTiles_.Changed(tile)) {
+                size_t firstX = (tile % columns) * TileWords * 64;
+                size_t firstY = (tile / columns) * BandHeight;
+                visitor(Tile{ firstX, std::min(firstX + (TileWords * 64), width_), firstY, std::min(firstY + BandHeight, height_) });
+            }
+        }
+    }
+
+private:
+    // How many rows are handed to a thread at once
+    static constexpr size_t BandHeight = 64;
+    // Tiles are BandHeight rows by TileWords * 64 columns
+    static constexpr size_t TileWords = 4;
+
+    LifeRule rule_;
+
+    size_t width_;
+    size_t height_;
+    size_t wordsPerRow_;
+    size_t stride_;
+
+    std::vector<uint64_t> cells_;
+    std::vector<uint64_t> nextCells_;
+    ActiveTiles activeTiles_;
+    uint64_t hash_ = 0;
+    bool hashStale_ = true;
+
+    uint64_t* Row(std::vector<uint64_t>& cells, size_t y) { return cells.data() + (y * stride_) + 1; }
+    const uint64_t* Row(const std::vector<uint64_t>& cells, size_t y) const { return cells.data() + (y * stride_) + 1; }
+
+    void RefreshGuards(size_t y);
+    void RefreshHash(ThreadPool& threads);
+    /**
+     * Steps words [firstWord, lastWord) of row y, returns true if any changed
+     * and XORs hashChange with their change to the hash.
+     */
+    bool StepRow(size_t y, size_t firstWord, size_t lastWord, uint64_t& hashChange);
+};
+
+#endif // LIFEENGINE_H
@@ -0,0 +1,285 @@
+#include "LifePlane.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Rounds towards negative infinity, so cell -1 is in chunk -1 rather than 0
+static int32_t ChunkOf(int64_t cell)
+{
+    return static_cast<int32_t>(cell >= 0 ? cell / LifePlane::ChunkSize : ((cell + 1) / LifePlane::ChunkSize) - 1);
+}
+
+LifePlane::LifePlane(LifeRule rule)
+    : rule_(rule)
+{
+    Clear();
+}
+
+void LifePlane::SetRule(LifeRule rule)
+{
+    rule_ = rule;
+    for (uint32_t index : live_) {
+        chunks_[index].changed = true;
+    }
+}
+
+void LifePlane::Clear()
+{
+    chunks_.clear();
+    freeChunks_.clear();
+    live_.clear();
+    slotBits_ = 6;
+    slots_.assign(size_t(1) << slotBits_, Slot{ 0, None });
+    processedCount_ = 0;
+    hash_ = 0;
+}
+
+bool LifePlane::Get(int64_t x, int64_t y) const
+{
+    return (GetWord(ChunkOf(x), y) >> (x - (int64_t{ ChunkOf(x) } * ChunkSize))) & 1;
+}
+
+uint64_t LifePlane::GetWord(int64_t wordX, int64_t y) const
+{
+    uint32_t index = Find(static_cast<int32_t>(wordX), ChunkOf(y));
+    return index == None ? 0 : chunks_[index].rows[y - (int64_t{ ChunkOf(y) } * ChunkSize)];
+}
+
+void LifePlane::SetWord(int64_t wordX, int64_t y, uint64_t word)
+{
+    uint32_t index = word != 0 ? FindOrCreate(static_cast<int32_t>(wordX), ChunkOf(y)) : Find(static_cast<int32_t>(wordX), ChunkOf(y));
+    if (index != None) {
+        Chunk& chunk = chunks_[index];
+        size_t row = static_cast<size_t>(y - (int64_t{ ChunkOf(y) } * ChunkSize));
+        hash_ ^= WordHash(chunk, row, chunk.rows[row]) ^ WordHash(chunk, row, word);
+        chunk.rows[row] = word;
+        chunk.changed = true;
+    }
+}
+
+void LifePlane::Step(ThreadPool& threads)
+{
+    // Only chunks that changed can have grown a live edge, the rest already have the neighbours they need
+    {
+        PROFILE_SCOPE("Extend frontier");
+        size_t existing = live_.size();
+        for (size_t i = 0; i < existing; ++i) {
+            if (chunks_[live_[i]].changed) {
+                ExtendFrontier(live_[i]);
+            }
+        }
+    }
+
+    // The map is only read from here on, so chunks can look up their neighbours concurrently
+    LifeWordStepper stepper(rule_);
+    threads.ParallelFor(live_.size(), [&](size_t i)
+    {
+        PROFILE_SCOPE("Step chunk");
+        Chunk& chunk = chunks_[live_[i]];
+        chunk.processed = StepChunk(chunk, stepper);
+    });
+
+    processedCount_ = 0;
+    for (uint32_t index : live_) {
+        Chunk& chunk = chunks_[index];
+        chunk.changed = chunk.processed && std::memcmp(chunk.rows, chunk.nextRows, sizeof(chunk.rows)) != 0;
+        if (chunk.changed) {
+            for (size_t row = 0; row < ChunkSize; ++row) {
+                if (chunk.rows[row] != chunk.nextRows[row]) {
+                    hash_ ^= WordHash(chunk, row, chunk.rows[row]) ^ WordHash(chunk, row, chunk.nextRows[row]);
+                }
+            }
+            std::memcpy(chunk.rows, chunk.nextRows, sizeof(chunk.rows));
+        }
+        processedCount_ += chunk.processed ? 1 : 0;
+    }
+
+    // An empty chunk that didn't change is dead either side of the step, so it can go unless a neighbour still reaches it
+    size_t kept = 0;
+    for (uint32_t index : live_) {
+        const Chunk& chunk = chunks_[index];
+        bool empty = std::all_of(std::begin(chunk.rows), std::end(chunk.rows), [](uint64_t word) { return word == 0; });
+        if (empty && !chunk.changed && !TouchedByNeighbours(chunk)) {
+            Erase(chunk);
+            freeChunks_.push_back(index);
+        } else {
+            live_[kept++] = index;
+        }
+    }
+    live_.resize(kept);
+}
+
+uint32_t LifePlane::Find(int32_t x, int32_t y) const
+{
+    uint64_t key = Key(x, y);
+    size_t mask = slots_.size() - 1;
+    for (size_t slot = SlotOf(key); slots_[slot].chunk != None; slot = (slot + 1) & mask) {
+        if (slots_[slot].key == key) {
+            return slots_[slot].chunk;
+        }
+    }
+    return None;
+}
+
+uint32_t LifePlane::FindOrCreate(int32_t x, int32_t y)
+{
+    uint32_t index = Find(x, y);
+    if (index != None) {
+        return index;
+    }
+
+    if ((live_.size() + 1) * 2 > slots_.size()) {
+        Rehash(slotBits_ + 1);
+    }
+
+    if (freeChunks_.empty()) {
+        index = static_cast<uint32_t>(chunks_.size());
+        chunks_.emplace_back();
+    } else {
+        index = freeChunks_.back();
+        freeChunks_.pop_back();
+    }
+    Chunk& chunk = chunks_[index];
+    std::fill(std::begin(chunk.rows), std::end(chunk.rows), 0);
+    chunk.x = x;
+    chunk.y = y;
+    // Empty before and after, whichever neighbour reached it has changed so it is stepped anyway
+    chunk.changed = false;
+    chunk.processed = false;
+    live_.push_back(index);
+
+    uint64_t key = Key(x, y);
+    size_t mask = slots_.size() - 1;
+    size_t slot = SlotOf(key);
+    while (slots_[slot].chunk != None) {
+        slot = (slot + 1) & mask;
+    }
+    slots_[slot] = { key, index };
+    return index;
+}
+
+void LifePlane::Erase(const Chunk& chunk)
+{
+    uint64_t key = Key(chunk.x, chunk.y);
+    size_t mask = slots_.size() - 1;
+    size_t slot = SlotOf(key);
+    while (slots_[slot].key != key || slots_[slot].chunk == None) {
+        slot = (slot + 1) & mask;
+    }
+
+    // Backward shift deletion, so that no tombstones are needed and lookups never probe further than they must
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; slots_[next].chunk != None; next = (next + 1) & mask) {
+        size_t home = SlotOf(slots_[next].key);
+        // Entries whose home lies cyclically in (hole, next] would become unreachable if moved
+        bool stays = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (!stays) {
+            slots_[hole] = slots_[next];
+            hole = next;
+        }
+    }
+    slots_[hole].chunk = None;
+}
+
+void LifePlane::Rehash(unsigned slotBits)
+{
+    std::vector<Slot> old(size_t(1) << slotBits, Slot{ 0, None });
+    std::swap(old, slots_);
+    slotBits_ = slotBits;
+    size_t mask = slots_.size() - 1;
+    for (const Slot& entry : old) {
+        if (entry.chunk != None) {
+            size_t slot = SlotOf(entry.key);
+            while (slots_[slot].chunk != None) {
+                slot = (slot + 1) & mask;
+            }
+            slots_[slot] = entry;
+        }
+    }
+}
+
+void LifePlane::ExtendFrontier(uint32_t index)
+{
+    // Copied, as creating a chunk may move every chunk
+    uint64_t top = chunks_[index].rows[0];
+    uint64_t bottom = chunks_[index].rows[ChunkSize - 1];
+    uint64_t left = 0;
+    uint64_t right = 0;
+    for (uint64_t word : chunks_[index].rows) {
+        left |= word & 1;
+        right |= word >> 63;
+    }
+    int32_t x = chunks_[index].x;
+    int32_t y = chunks_[index].y;
+
+    bool reaches[3][3] = {
+        { (top & 1) != 0, top != 0, (top >> 63) != 0 },
+        { left != 0, false, right != 0 },
+        { (bottom & 1) != 0, bottom != 0, (bottom >> 63) != 0 },
+    };
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            if (reaches[dy + 1][dx + 1]) {
+                FindOrCreate(x + dx, y + dy);
+            }
+        }
+    }
+}
+
+bool LifePlane::TouchedByNeighbours(const Chunk& chunk) const
+{
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            uint32_t index = (dx != 0 || dy != 0) ? Find(chunk.x + dx, chunk.y + dy) : None;
+            if (index == None) {
+                continue;
+            }
+            // The neighbour's rows and columns facing this chunk, e.g. its bottom row if it is above
+            const Chunk& neighbour = chunks_[index];
+            uint64_t columns = dx < 0 ? uint64_t(1) << 63 : dx > 0 ? 1 : ~uint64_t(0);
+            size_t firstRow = dy > 0 ? 0 : dy < 0 ? ChunkSize - 1 : 0;
+            size_t lastRow = dy < 0 ? ChunkSize : dy > 0 ? 1 : ChunkSize;
+            for (size_t row = firstRow; row < lastRow; ++row) {
+                if (neighbour.rows[row] & columns) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool LifePlane::StepChunk(Chunk& chunk, const LifeWordStepper& stepper) const
+{
+    const Chunk* neighbours[3][3];
+    bool changed = false;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            uint32_t index = Find(chunk.x + dx, chunk.y + dy);
+            neighbours[dy + 1][dx + 1] = index == None ? nullptr : &chunks_[index];
+            changed |= index != None && chunks_[index].changed;
+        }
+    }
+    // Everything in reach is as it was last generation, so this chunk will be too
+    if (!changed) {
+        return false;
+    }
+
+    // The chunk's rows with the word either side, and the row either side, laid out as LifeWordStepper reads them
+    uint64_t words[ChunkSize + 2][3];
+    for (int64_t row = -1; row <= ChunkSize; ++row) {
+        int dy = row < 0 ? -1 : row >= ChunkSize ? 1 : 0;
+        size_t rowInChunk = static_cast<size_t>(row - (dy * ChunkSize));
+        for (int dx = -1; dx <= 1; ++dx) {
+            const Chunk* neighbour = neighbours[dy + 1][dx + 1];
+            words[row + 1][dx + 1] = neighbour ? neighbour->rows[rowInChunk] : 0;
+        }
+    }
+
+    for (size_t row = 0; row < ChunkSize; ++row) {
+        chunk.nextRows[row] = stepper.Next(&words[row][1], &words[row + 1][1], &words[row + 2][1]);
+    }
+    return true;
+}
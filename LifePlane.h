@@ -0,0 +1,133 @@
+#ifndef LIFEPLANE_H
+#define LIFEPLANE_H
+
+#include "LifeRule.h"
+#include "LifeEngine.h"
+#include "ThreadPool.h"
+#include "CellHash.h"
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Steps a LifeRule on an unbounded plane rather than a torus, so nothing ever
+ * wraps around into its own debris.
+ *
+ * The plane is stored as chunks of ChunkSize by ChunkSize cells, a word per
+ * row of each, kept in an open addressing hash map keyed by the chunk's
+ * coordinates. Only chunks with live cells, or next to one with live cells on
+ * the edge they share, are kept: a chunk is created once a neighbour's cells
+ * reach it, and freed once it has been empty and unchanged for a generation.
+ * Chunks are only stepped when they, or one of their neighbours, changed in
+ * the previous generation, so both memory and time follow the population
+ * rather than the area it is spread across.
+ *
+ * Chunk coordinates are 32 bit, so the plane is "only" 2^37 cells across.
+ * Rules with B0 can't be stepped, as every empty chunk would come alive.
+ */
+class LifePlane {
+public:
+    // A chunk's rows are one word each
+    static constexpr int64_t ChunkSize = 64;
+
+    LifePlane(LifeRule rule = LifeRule::Conway());
+
+    void SetRule(LifeRule rule);
+    const LifeRule& GetRule() const { return rule_; }
+
+    /**
+     * Every cell is dead.
+     */
+    void Clear();
+
+    bool Get(int64_t x, int64_t y) const;
+    /**
+     * The 64 cells from (64 * wordX, y), as LifeEngine stores them, i.e. bit n
+     * is the cell n to the right. Setting a non-zero word creates its chunk.
+     */
+    uint64_t GetWord(int64_t wordX, int64_t y) const;
+    void SetWord(int64_t wordX, int64_t y, uint64_t word);
+
+    void Step(ThreadPool& threads);
+
+    /**
+     * See CellHash, kept up to date as words are set and stepped.
+     */
+    uint64_t Hash() const { return hash_; }
+
+    size_t ChunkCount() const { return live_.size(); }
+    size_t ChunksProcessed() const { return processedCount_; }
+
+    /**
+     * Calls visitor(wordX, firstY, rows) for every chunk that changed in the
+     * last Step(), where rows are the chunk's ChunkSize words, from the top.
+     */
+    template <typename Visitor>
+    void ForEachChangedChunk(Visitor&& visitor) const
+    {
+        for (uint32_t index : live_) {
+            const Chunk& chunk = chunks_[index];
+            if (chunk.changed) {
+                visitor(int64_t{ chunk.x }, int64_t{ chunk.y } * ChunkSize, chunk.rows);
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Chunk {
+        uint64_t rows[ChunkSize];
+        uint64_t nextRows[ChunkSize];
+        int32_t x;
+        int32_t y;
+        // Whether rows changed in the last Step()
+        bool changed;
+        // Whether it was stepped in the last Step(), nextRows are stale if not
+        bool processed;
+    };
+
+    struct Slot {
+        uint64_t key;
+        uint32_t chunk;
+    };
+
+    LifeRule rule_;
+    size_t processedCount_ = 0;
+    uint64_t hash_ = 0;
+
+    // Chunks are never moved once created, freed chunks are reused
+    std::vector<Chunk> chunks_;
+    std::vector<uint32_t> freeChunks_;
+    // Every chunk in use, in no particular order
+    std::vector<uint32_t> live_;
+    // 2^slotBits_ of them, never more than half full
+    std::vector<Slot> slots_;
+    unsigned slotBits_ = 0;
+
+    static uint64_t Key(int32_t x, int32_t y) { return (uint64_t(uint32_t(x)) << 32) | uint32_t(y); }
+    static uint64_t WordHash(const Chunk& chunk, size_t row, uint64_t word) { return CellHash::Of(Key(chunk.x, chunk.y) ^ (row * 0x9E3779B97F4A7C15ull), word); }
+    // Fibonacci hashing, the top bits of the product are well mixed even for neighbouring keys
+    size_t SlotOf(uint64_t key) const { return (key * 0x9E3779B97F4A7C15ull) >> (64 - slotBits_); }
+
+    uint32_t Find(int32_t x, int32_t y) const;
+    uint32_t FindOrCreate(int32_t x, int32_t y);
+    void Erase(const Chunk& chunk);
+    void Rehash(unsigned slotBits);
+
+    /**
+     * Creates the neighbours of the chunk that its live edges reach.
+     */
+    void ExtendFrontier(uint32_t index);
+    /**
+     * Whether any neighbour of the chunk has live cells on the edge they share.
+     */
+    bool TouchedByNeighbours(const Chunk& chunk) const;
+    /**
+     * Writes the chunk's next generation into nextRows, returns false without
+     * doing so if neither it nor its neighbours changed last generation.
+     */
+    bool StepChunk(Chunk& chunk, const LifeWordStepper& stepper) const;
+};
+
+#endif // LIFEPLANE_H
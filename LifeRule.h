@@ -0,0 +1,50 @@
+#ifndef LIFERULE_H
+#define LIFERULE_H
+
+#include "Neighbourhood.h"
+#include "Stencil.h"
+
+#include <stdint.h>
+
+/**
+ * A binary, outer totalistic rule on the eight cell Moore neighbourhood, i.e.
+ * any "Life-like" rule such as B3/S23. Bit n of birth is set if a dead cell
+ * with n live neighbours comes alive, bit n of survival if a live one stays
+ * alive. Any non-zero cell value counts as alive.
+ *
+ * Usable as a stencil rule, but CellularAutomata hands these to LifeEngine.
+ */
+struct LifeRule {
+    static constexpr int Bitmap[3][3] = {
+        { 1, 1, 1 },
+        { 1, 0, 1 },
+        { 1, 1, 1 },
+    };
+    static constexpr auto Coordinates = Neighbourhood::CreateNeighbourhoodCoordinates<Neighbourhood::CountNeighbours(Bitmap)>(Bitmap);
+    static constexpr unsigned Radius = Neighbourhood::Radius(Coordinates);
+
+    uint16_t birth;
+    uint16_t survival;
+
+    static constexpr LifeRule Conway() { return { 1 << 3, (1 << 2) | (1 << 3) }; }
+
+    bool operator==(const LifeRule& other) const { return birth == other.birth && survival == other.survival; }
+    bool operator!=(const LifeRule& other) const { return !(*this == other); }
+
+    bool NextState(bool alive, unsigned liveNeighbours) const
+    {
+        return ((alive ? survival : birth) >> liveNeighbours) & 1;
+    }
+
+    template <typename CellType>
+    CellType operator()(const Neighbours<CellType>& cell) const
+    {
+        unsigned liveNeighbours = 0;
+        for (const auto& [xOffset, yOffset] : Coordinates) {
+            liveNeighbours += cell(xOffset, yOffset) != 0 ? 1 : 0;
+        }
+        return NextState(cell(0, 0) != 0, liveNeighbours) ? 1 : 0;
+    }
+};
+
+#endif // LIFERULE_H
@@ -3,11 +3,28 @@
 
 #include "NeuralNetwork.h"
 #include "Neighbourhood.h"
+#include "Rules.h"
+#include "TableRule.h"
+#include "BuiltInRules.h"
+#include "Checkpoint.h"
+#include "Pattern.h"
+#include "Profiler.h"
+
+#include <QFileDialog>
+#include <QSignalBlocker>
+
+#include <fstream>
+#include <sstream>
+
+#include <random>
+#include <limits>
+#include <algorithm>
+
+static const char* FileFilters = "Checkpoints (*.checkpoint);;RLE Patterns (*.rle);;Macrocells, save only (*.mc)";
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , timer_(new QTimer(this))
 {
     ui->setupUi(this);
 
@@ -17,7 +34,7 @@ MainWindow::MainWindow(QWidget *parent)
     SetupRandomiserControlls();
     SetupCellsControlls();
     // Do last so all other settings are applied before the sim starts
-    SetupTimer();
+    ui->cellularAutomata->SetRunning(!ui->speedPaused->isChecked());
 }
 
 MainWindow::~MainWindow()
@@ -25,27 +42,63 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
-void MainWindow::SetupTimer()
-{
-    connect(timer_, &QTimer::timeout, [&]()
-    {
-        ui->cellularAutomata->Step();
-    });
-    timer_->setSingleShot(false);
-    timer_->start();
-}
-
 void MainWindow::SetupSpeedControlls()
 {
     ui->speedCustomSpinner->setMinimum(1);
+    ui->speedJumpSpinner->setRange(0, 40);
+    ui->speedJumpSpinner->setValue(10);
 
-    connect(ui->speed1Hz, &QRadioButton::toggled, [&](bool checked) { if (checked) timer_->setInterval(1000 / 1); });
-    connect(ui->speed5Hz, &QRadioButton::toggled, [&](bool checked) { if (checked) timer_->setInterval(1000 / 5); });
-    connect(ui->speedMax, &QRadioButton::toggled, [&](bool checked) { if (checked) timer_->setInterval(0); });
-    connect(ui->speedCustom, &QRadioButton::toggled, [&](bool checked) { if (checked) timer_->setInterval(1000 / ui->speedCustomSpinner->value()); });
-    connect(ui->speedPaused, &QCheckBox::toggled, [&](bool checked) { checked ? timer_->stop() : timer_->start(); });
+    auto& ca = *ui->cellularAutomata;
+    using std::chrono::milliseconds;
+    connect(ui->speed1Hz, &QRadioButton::toggled, [&](bool checked) { if (checked) ca.SetStepInterval(milliseconds(1000 / 1)); });
+    connect(ui->speed5Hz, &QRadioButton::toggled, [&](bool checked) { if (checked) ca.SetStepInterval(milliseconds(1000 / 5)); });
+    connect(ui->speedMax, &QRadioButton::toggled, [&](bool checked) { if (checked) ca.SetStepInterval(milliseconds(0)); });
+    connect(ui->speedCustom, &QRadioButton::toggled, [&](bool checked) { if (checked) ca.SetStepInterval(milliseconds(1000 / ui->speedCustomSpinner->value())); });
+    connect(ui->speedPaused, &QCheckBox::toggled, [&](bool checked) { ca.SetRunning(!checked); });
     connect(ui->speedStepOnce, &QPushButton::pressed, [&]() { ui->cellularAutomata->Step(); });
-    connect(ui->speedCustomSpinner, qOverload<int>(&QSpinBox::valueChanged), [&](int) { if (ui->speedCustom->isChecked()) timer_->setInterval(1000 / ui->speedCustomSpinner->value()); });
+    connect(ui->speedJump, &QPushButton::pressed, [&]()
+    {
+        if (ca.Jumping()) {
+            ca.CancelJump();
+        } else {
+            ca.FastForward(static_cast<unsigned>(ui->speedJumpSpinner->value()));
+            ui->speedJump->setText("Cancel Jump");
+        }
+    });
+    connect(ui->cellularAutomata, &CellularAutomata::JumpProgress, [&](quint64 generationsDone, quint64 generations)
+    {
+        double percent = 100.0 * static_cast<double>(generationsDone) / static_cast<double>(generations);
+        ui->statusbar->showMessage(QString("Jumping, %1 of %2 generations (%3%)").arg(generationsDone).arg(generations).arg(percent, 0, 'f', 1));
+    });
+    connect(ui->cellularAutomata, &CellularAutomata::JumpFinished, [&](bool cancelled)
+    {
+        ui->speedJump->setText("Jump");
+        ui->statusbar->showMessage(cancelled ? "Jump cancelled" : "Jump finished", 5000);
+    });
+    connect(ui->cellularAutomata, &CellularAutomata::Settled, [&](quint64 generation, quint64 period)
+    {
+        ui->speedPaused->setChecked(true);
+        ui->statusbar->showMessage(QString("Settled into a period %1 cycle by generation %2").arg(period).arg(generation));
+    });
+    connect(ui->speedShowStats, &QCheckBox::toggled, [&](bool show) { ca.SetShowStats(show); });
+    connect(ui->speedSaveTrace, &QPushButton::pressed, [&]()
+    {
+        QString path = QFileDialog::getSaveFileName(this, "Save Trace", QString(), "Chrome Traces (*.json)");
+        std::string error;
+        if (path.isEmpty()) {
+            return;
+        }
+        std::ofstream file(path.toStdString());
+        if (!file) {
+            ui->statusbar->showMessage("Couldn't write " + path, 5000);
+        } else if (Profiler::WriteTrace(file, error)) {
+            ui->statusbar->showMessage("Saved " + path, 5000);
+        } else {
+            ui->statusbar->showMessage(QString::fromStdString(error), 5000);
+        }
+    });
+    ui->speedSaveTrace->setEnabled(Profiler::Enabled);
+    connect(ui->speedCustomSpinner, qOverload<int>(&QSpinBox::valueChanged), [&](int) { if (ui->speedCustom->isChecked()) ca.SetStepInterval(milliseconds(1000 / ui->speedCustomSpinner->value())); });
 
     ui->speed5Hz->setChecked(true);
 }
@@ -58,7 +111,7 @@ void MainWindow::SetupColourControlls()
     connect(ui->colourMonochrome, &QRadioButton::toggled, [&](bool checked)
     {
         if (checked) {
-            ca.SetCellColouriser(ca.GetDefaultCellColouriser());
+            ca.SetCellColouriser(ca.GetDefaultCellColouriser(), 0.0, 1.0);
         }
     });
     connect(ui->colourTrichromatic, &QRadioButton::toggled, [&](bool checked)
@@ -67,7 +120,7 @@ void MainWindow::SetupColourControlls()
             ca.SetCellColouriser([](const double& value) -> unsigned
             {
                 return value < -0.33 ? 0x00FF0000 : value > 0.33 ? 0x0000FF00 : 0x000000FF;
-            });
+            }, -1.0, 1.0);
         }
     });
     connect(ui->colourDumbChromatic, &QRadioButton::toggled, [&](bool checked)
@@ -85,10 +138,12 @@ void MainWindow::SetupColourControlls()
             ca.SetCellColouriser([](const double& value) -> unsigned
             {
                 return ((value + 1) / 2) * 0x00FFFFFF;
-            });
+            }, -1.0, 1.0);
         }
     });
 
+    connect(ui->colourZoomedOutMaxima, &QCheckBox::toggled, [&](bool maxima) { ca.SetZoomedOutMaxima(maxima); });
+
     ui->colourMonochrome->setChecked(true);
 }
 
@@ -99,170 +154,115 @@ void MainWindow::SetupRulesControlls()
     connect(ui->rulesConway, &QRadioButton::toggled, [&](bool checked)
     {
         if (checked) {
-            ca.SetCellStepper(ca.GetDefaultCellStepper());
+            ca.SetCellRule(LifeRule::Conway());
         }
     });
     connect(ui->rulesNeuralNet, &QRadioButton::toggled, [&](bool checked)
     {
         if (checked) {
-            static NeuralNetwork network(3, 8, NeuralNetwork::InitialWeights::Random);
-            static std::vector<double> neighbourhood;
-            network = NeuralNetwork(3, 8, NeuralNetwork::InitialWeights::Random);
-            ca.SetCellStepper([&](const CellularAutomata::GetNeighbourFunc& getCellValue) -> double
-            {
-                neighbourhood = {
-                    getCellValue(-1, -1),
-                    getCellValue(-1,  0),
-                    getCellValue(-1,  1),
-                    getCellValue( 0, -1),
-                    getCellValue( 0,  1),
-                    getCellValue( 1, -1),
-                    getCellValue( 1,  0),
-                    getCellValue( 1,  1),
-                };
-                network.ForwardPropogate(neighbourhood);
-                return (neighbourhood[0] + neighbourhood[4] + getCellValue(0, 0)) / 3.0;
-            });
+            auto network = std::make_shared<NeuralNetwork<float>>(3, 8, NeuralNetwork<float>::InitialWeights::Random);
+            std::ostringstream weights;
+            network->Write(weights);
+            neuralNet_ = weights.str();
+            ca.SetCellRule(NeuralNetRule<float>{ std::move(network) });
         }
     });
     connect(ui->rulesMultipleNeighbourhoods, &QRadioButton::toggled, [&](bool checked)
     {
         if (checked) {
-            static auto neighbourhood1 = Neighbourhood::CreateNeighbourhoodCoordinates(
-            {
-                { 0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0, },
-                { 0,0,0,0,0,1,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,1,0,0,0,0,0, },
-                { 0,0,0,0,1,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,1,0,0,0,0, },
-                { 0,0,0,1,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,1,0,0,0, },
-                { 0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0, },
-                { 0,0,1,0,0,0,1,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,1,0,0,0,1,0,0, },
-                { 0,0,1,0,0,0,1,0,0,1,0,0,0,1,1,1,0,0,0,1,0,0,1,0,0,0,1,0,0, },
-                { 0,1,0,0,0,1,0,0,1,0,0,1,1,0,0,0,1,1,0,0,1,0,0,1,0,0,0,1,0, },
-                { 0,1,0,0,0,1,0,0,1,0,1,0,0,1,1,1,0,0,1,0,1,0,0,1,0,0,0,1,0, },
-                { 0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0, },
-                { 1,0,0,0,1,0,0,1,0,1,0,1,0,1,1,1,0,1,0,1,0,1,0,0,1,0,0,0,1, },
-                { 1,0,0,0,1,0,0,1,0,1,0,1,0,1,1,1,0,1,0,1,0,1,0,0,1,0,0,0,1, },
-                { 1,0,0,0,1,0,0,1,0,1,0,1,0,1,1,1,0,1,0,1,0,1,0,0,1,0,0,0,1, },
-                { 0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0, },
-                { 0,1,0,0,0,1,0,0,1,0,1,0,0,1,1,1,0,0,1,0,1,0,0,1,0,0,0,1,0, },
-                { 0,1,0,0,0,1,0,0,1,0,0,1,1,0,0,0,1,1,0,0,1,0,0,1,0,0,0,1,0, },
-                { 0,0,1,0,0,0,1,0,0,1,0,0,0,1,1,1,0,0,0,1,0,0,1,0,0,0,1,0,0, },
-                { 0,0,1,0,0,0,1,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,1,0,0,0,1,0,0, },
-                { 0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0, },
-                { 0,0,0,1,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,1,0,0,0, },
-                { 0,0,0,0,1,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,1,0,0,0,0, },
-                { 0,0,0,0,0,1,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,1,0,0,0,0,0, },
-                { 0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0, },
-            });
-            static auto neighbourhood2 = Neighbourhood::CreateNeighbourhoodCoordinates(
-            {
-                { 0,0,1,1,1,0,0, },
-                { 0,1,0,0,0,1,0, },
-                { 1,0,1,1,1,0,1, },
-                { 1,0,1,0,1,0,1, },
-                { 1,0,1,1,1,0,1, },
-                { 0,1,0,0,0,1,0, },
-                { 0,0,1,1,1,0,0, },
-            });
-            static auto neighbourhood3 = Neighbourhood::CreateNeighbourhoodCoordinates(
-            {
-                { 0,0,0,0,0,1,1,1,0,0,0,0,0 },
-                { 0,0,0,1,1,1,1,1,1,1,0,0,0 },
-                { 0,0,1,1,1,1,1,1,1,1,1,0,0 },
-                { 0,1,1,1,1,0,0,0,1,1,1,1,0 },
-                { 0,1,1,1,0,0,0,0,0,1,1,1,0 },
-                { 1,1,1,0,0,0,0,0,0,0,1,1,1 },
-                { 1,1,1,0,0,0,0,0,0,0,1,1,1 },
-                { 1,1,1,0,0,0,0,0,0,0,1,1,1 },
-                { 0,1,1,1,0,0,0,0,0,1,1,1,0 },
-                { 0,1,1,1,1,0,0,0,1,1,1,1,0 },
-                { 0,0,1,1,1,1,1,1,1,1,1,0,0 },
-                { 0,0,0,1,1,1,1,1,1,1,0,0,0 },
-                { 0,0,0,0,0,1,1,1,0,0,0,0,0 },
-            });
-            static auto neighbourhood4 = Neighbourhood::CreateNeighbourhoodCoordinates(
-            {
-                { 0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0, },
-                { 0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0, },
-                { 0,0,0,0,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,0,0,0,0, },
-                { 0,0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0,0, },
-                { 0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0, },
-                { 0,0,1,1,1,1,0,0,0,0,0,0,1,1,1,1,1,0,0,0,0,0,0,1,1,1,1,0,0, },
-                { 0,1,1,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,1,1,0, },
-                { 0,1,1,1,1,0,0,0,0,1,0,0,0,0,0,0,0,0,0,1,0,0,0,0,1,1,1,1,0, },
-                { 0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0, },
-                { 1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1, },
-                { 1,1,1,1,0,0,0,1,0,0,0,1,0,0,0,0,0,1,0,0,0,1,0,0,0,1,1,1,1, },
-                { 1,1,1,1,0,0,0,1,0,0,1,0,0,1,1,1,0,0,1,0,0,1,0,0,0,1,1,1,1, },
-                { 1,1,1,1,0,0,0,1,0,0,1,0,0,1,0,1,0,0,1,0,0,1,0,0,0,1,1,1,1, },
-                { 1,1,1,1,0,0,0,1,0,0,1,0,0,1,1,1,0,0,1,0,0,1,0,0,0,1,1,1,1, },
-                { 1,1,1,1,0,0,0,1,0,0,0,1,0,0,0,0,0,1,0,0,0,1,0,0,0,1,1,1,1, },
-                { 1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1, },
-                { 0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0, },
-                { 0,1,1,1,1,0,0,0,0,1,0,0,0,0,0,0,0,0,0,1,0,0,0,0,1,1,1,1,0, },
-                { 0,1,1,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,1,1,0, },
-                { 0,0,1,1,1,1,0,0,0,0,0,0,1,1,1,1,1,0,0,0,0,0,0,1,1,1,1,0,0, },
-                { 0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0, },
-                { 0,0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0,0, },
-                { 0,0,0,0,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,0,0,0,0, },
-                { 0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0, },
-                { 0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0, },
-                { 0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0, },
-            });
-            ca.SetCellStepper([&](const CellularAutomata::GetNeighbourFunc& getCellValue) -> double
-            {
-                double neighbours1 = 0.0;
-                for (auto coord : neighbourhood1) {
-                    neighbours1 += getCellValue(coord.first, coord.second);
-                }
-                double neighbours2 = 0.0;
-                for (auto coord : neighbourhood2) {
-                    neighbours2 += getCellValue(coord.first, coord.second);
-                }
-                double neighbours3 = 0.0;
-                for (auto coord : neighbourhood3) {
-                    neighbours3 += getCellValue(coord.first, coord.second);
-                }
-                double neighbours4 = 0.0;
-                for (auto coord : neighbourhood4) {
-                    neighbours4 += getCellValue(coord.first, coord.second);
-                }
-
-                double value = getCellValue(0, 0);
-                if (neighbours1 >= 0 && neighbours1 <= 17) {
-                    value = 0;
-                }
-                if (neighbours1 >= 40 && neighbours1 <= 42) {
-                    value = 1;
-                }
-                if (neighbours2 >= 10 && neighbours2 <= 13) {
-                    value = 1;
-                }
-                if (neighbours3 >= 9 && neighbours3 <= 21) {
-                    value = 0;
-                }
-                if (neighbours4 >= 78 && neighbours4 <= 89) {
-                    value = 0;
-                }
-                if (neighbours4 > 108) {
-                    value = 0;
-                }
-                return value;
-            });
+            ca.SetCellRule(MultipleNeighbourhoodsRule());
+        }
+    });
+    connect(ui->rulesLenia, &QRadioButton::toggled, [&](bool checked)
+    {
+        if (checked) {
+            ca.SetCellRule(LeniaRule::Orbium());
+        }
+    });
+
+    connect(ui->rulesNotation, &QRadioButton::toggled, [&](bool checked)
+    {
+        if (checked) {
+            ApplyRuleNotation();
+        }
+    });
+    connect(ui->rulesNotationEdit, &QLineEdit::editingFinished, [&]()
+    {
+        if (ui->rulesNotation->isChecked()) {
+            ApplyRuleNotation();
+        } else {
+            ui->rulesNotation->setChecked(true);
         }
     });
     ui->rulesConway->setChecked(true);
 }
 
+void MainWindow::ApplyRuleNotation()
+{
+    std::string error;
+    if (std::optional<TableRule> rule = TableRule::Compile(ui->rulesNotationEdit->text().toStdString(), error)) {
+        ui->cellularAutomata->SetCellRule(std::move(*rule));
+    } else {
+        ui->statusbar->showMessage(QString::fromStdString(error), 5000);
+    }
+}
+
+std::string MainWindow::RuleName() const
+{
+    if (ui->rulesNeuralNet->isChecked()) {
+        return "neuralnet";
+    } else if (ui->rulesMultipleNeighbourhoods->isChecked()) {
+        return "multipleneighbourhoods";
+    } else if (ui->rulesLenia->isChecked()) {
+        return "lenia";
+    } else if (ui->rulesNotation->isChecked()) {
+        return ui->rulesNotationEdit->text().toStdString();
+    }
+    return "conway";
+}
+
+QRadioButton* MainWindow::RuleButton(const std::string& rule) const
+{
+    if (rule == "conway") {
+        return ui->rulesConway;
+    } else if (rule == "neuralnet") {
+        return ui->rulesNeuralNet;
+    } else if (rule == "multipleneighbourhoods") {
+        return ui->rulesMultipleNeighbourhoods;
+    } else if (rule == "lenia") {
+        return ui->rulesLenia;
+    }
+    return ui->rulesNotation;
+}
+
+std::string MainWindow::RuleData() const
+{
+    return ui->rulesNeuralNet->isChecked() ? neuralNet_ : std::string();
+}
+
+void MainWindow::SelectRule(const std::string& rule)
+{
+    // A rule that is already selected is left as it is, i.e. the neural net keeps its weights
+    QRadioButton* button = RuleButton(rule);
+    if (button == ui->rulesNotation) {
+        ui->rulesNotationEdit->setText(QString::fromStdString(rule));
+        if (button->isChecked()) {
+            ApplyRuleNotation();
+        }
+    }
+    button->setChecked(true);
+}
+
+void MainWindow::ShowRule(const std::string& rule)
+{
+    QRadioButton* button = RuleButton(rule);
+    if (button == ui->rulesNotation) {
+        ui->rulesNotationEdit->setText(QString::fromStdString(rule));
+    }
+    QSignalBlocker blocker(button);
+    button->setChecked(true);
+}
+
 void MainWindow::SetupRandomiserControlls()
 {
     ui->randMin->setValue(0.0);
@@ -273,22 +273,109 @@ void MainWindow::SetupRandomiserControlls()
 
     connect(ui->randApply, &QPushButton::pressed, [&]()
     {
+        // A fresh grid every press
+        seed_ = (uint64_t{ std::random_device{}() } << 32) | std::random_device{}();
         if (ui->randIntegersOnly->isChecked()) {
-            ui->cellularAutomata->Randomise<int>(ui->randMin->value(), ui->randMax->value());
+            ui->cellularAutomata->Randomise<int>(ui->randMin->value(), ui->randMax->value(), seed_);
         } else {
-            ui->cellularAutomata->Randomise<double>(ui->randMin->value(), ui->randMax->value());
+            ui->cellularAutomata->Randomise<double>(ui->randMin->value(), ui->randMax->value(), seed_);
         }
     });
 }
 
 void MainWindow::SetupCellsControlls()
 {
-    ui->cellsWidthSpinner->setRange(0, 1000);
+    // As large as a spinner goes, so that the size of anything loaded can be shown and applied again
+    ui->cellsWidthSpinner->setRange(0, std::numeric_limits<int>::max());
     ui->cellsWidthSpinner->setValue(100);
-    ui->cellsHeightSpinner->setRange(0, 1000);
+    ui->cellsHeightSpinner->setRange(0, std::numeric_limits<int>::max());
     ui->cellsHeightSpinner->setValue(100);
 
     connect(ui->cellsClear, &QPushButton::pressed, [&]() { ui->cellularAutomata->Clear(); });
     connect(ui->cellsSizeApplyButton, &QPushButton::pressed, [&]() { ui->cellularAutomata->SetDimensions(ui->cellsWidthSpinner->value(), ui->cellsHeightSpinner->value()); });
+    connect(ui->cellsUnbounded, &QCheckBox::toggled, [&](bool unbounded) { ui->cellularAutomata->SetUnbounded(unbounded); });
+    connect(ui->cellsSave, &QPushButton::pressed, [&]()
+    {
+        QString path = QFileDialog::getSaveFileName(this, "Save Cells", QString(), FileFilters);
+        std::string error;
+        if (path.isEmpty()) {
+            return;
+        } else if (SaveCells(path.toStdString(), error)) {
+            ui->statusbar->showMessage("Saved " + path, 5000);
+        } else {
+            ui->statusbar->showMessage(QString::fromStdString(error), 5000);
+        }
+    });
+    connect(ui->cellsLoad, &QPushButton::pressed, [&]()
+    {
+        QString path = QFileDialog::getOpenFileName(this, "Load Cells", QString(), FileFilters);
+        std::string error;
+        if (path.isEmpty()) {
+            return;
+        } else if (LoadCells(path.toStdString(), error)) {
+            size_t maxSide = static_cast<size_t>(std::numeric_limits<int>::max());
+            ui->cellsWidthSpinner->setValue(static_cast<int>(std::min(ui->cellularAutomata->Columns(), maxSide)));
+            ui->cellsHeightSpinner->setValue(static_cast<int>(std::min(ui->cellularAutomata->Rows(), maxSide)));
+            ui->statusbar->showMessage("Loaded " + path, 5000);
+        } else {
+            ui->statusbar->showMessage(QString::fromStdString(error), 5000);
+        }
+    });
+}
+
+static bool EndsWith(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool MainWindow::SaveCells(const std::string& path, std::string& error)
+{
+    if (!EndsWith(path, ".rle") && !EndsWith(path, ".mc")) {
+        return ui->cellularAutomata->SaveCheckpoint(path, RuleName(), RuleData(), seed_, error);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    // Other Life software knows Conway's rule by its notation
+    std::string rule = ui->rulesConway->isChecked() ? "B3/S23" : RuleName();
+    if (!file || !ui->cellularAutomata->WritePattern(file, rule, EndsWith(path, ".mc"))) {
+        error = "Couldn't write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool MainWindow::LoadCells(const std::string& path, std::string& error)
+{
+    // The rule first in both cases, so the cells are read straight into whichever engine it uses
+    if (!EndsWith(path, ".rle")) {
+        // Only once the file checks out, so a bad one leaves the rule alone along with the cells
+        std::string ruleData;
+        std::optional<Checkpoint::Info> info = ui->cellularAutomata->LoadCheckpoint(path, [&](Automaton& automaton, const Checkpoint::Info& info, std::string& error)
+        {
+            ruleData = info.ruleData;
+            return SetBuiltInRule(automaton, info.rule, ruleData, error);
+        }, error);
+        if (info) {
+            ShowRule(info->rule);
+            if (info->rule == "neuralnet") {
+                neuralNet_ = ruleData;
+            }
+            seed_ = info->seed;
+        }
+        return info.has_value();
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    Pattern::RleHeader header;
+    if (!file) {
+        error = "Couldn't open " + path;
+        return false;
+    } else if (!Pattern::ReadRleHeader(file, header, error)) {
+        return false;
+    }
+    if (!header.rule.empty()) {
+        SelectRule(header.rule);
+    }
+    return ui->cellularAutomata->ReadPattern(file, header, error);
 }
 
@@ -2,12 +2,16 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTimer>
+
+#include <string>
+#include <stdint.h>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+class QRadioButton;
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
 public:
@@ -16,14 +20,37 @@ public:
 
 private:
     Ui::MainWindow *ui;
+    // What the cells were last randomised from, saved with them
+    uint64_t seed_ = 0;
+    // The neural net's weights while it is selected, see SetBuiltInRule
+    std::string neuralNet_;
 
-    QTimer* timer_;
-
-    void SetupTimer();
     void SetupSpeedControlls();
     void SetupColourControlls();
     void SetupRulesControlls();
     void SetupRandomiserControlls();
     void SetupCellsControlls();
+
+    void ApplyRuleNotation();
+    /**
+     * The selected rule as SetBuiltInRule would name it, and the reverse.
+     */
+    std::string RuleName() const;
+    void SelectRule(const std::string& rule);
+    /**
+     * What Checkpoint saves alongside RuleName(), see SetBuiltInRule.
+     */
+    std::string RuleData() const;
+    /**
+     * Only checks the rule's control, for a rule already set on the automaton.
+     */
+    void ShowRule(const std::string& rule);
+    QRadioButton* RuleButton(const std::string& rule) const;
+    /**
+     * As a checkpoint, or as a pattern if path ends in .rle or .mc. False, and
+     * error says why, if it couldn't.
+     */
+    bool SaveCells(const std::string& path, std::string& error);
+    bool LoadCells(const std::string& path, std::string& error);
 };
 #endif // MAINWINDOW_H
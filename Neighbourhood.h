@@ -2,10 +2,22 @@
 #define NEIGHBOURHOOD_H
 
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdlib>
 #include <assert.h>
 
 class Neighbourhood {
 public:
+    /**
+     * A horizontal line of neighbours, from firstX to lastX inclusive.
+     */
+    struct Run {
+        int yOffset;
+        int firstX;
+        int lastX;
+    };
+
     static std::vector<std::pair<int, int>> CreateNeighbourhoodCoordinates(std::vector<std::vector<int>>&& bitmap)
     {
         assert(bitmap.size() % 2 == 1);
@@ -25,6 +37,121 @@ public:
         }
         return coordinates;
     }
+
+    /**
+     * Compile time equivalent of the above, for use in rules that want their
+     * neighbour reads unrolled and inlined, e.g.
+     *
+     * static constexpr int bitmap[3][3] = { ... };
+     * static constexpr auto coordinates = CreateNeighbourhoodCoordinates<CountNeighbours(bitmap)>(bitmap);
+     */
+    template <size_t Count, size_t Rows, size_t Columns>
+    static constexpr std::array<std::pair<int, int>, Count> CreateNeighbourhoodCoordinates(const int (&bitmap)[Rows][Columns])
+    {
+        static_assert(Rows % 2 == 1 && Columns % 2 == 1, "Neighbourhood bitmaps need a centre cell");
+        std::array<std::pair<int, int>, Count> coordinates{};
+        size_t index = 0;
+        for (size_t row = 0; row < Rows; row++) {
+            for (size_t column = 0; column < Columns; column++) {
+                if (bitmap[row][column] == 1) {
+                    coordinates[index].first = static_cast<int>(row) - static_cast<int>(Rows / 2);
+                    coordinates[index].second = static_cast<int>(column) - static_cast<int>(Columns / 2);
+                    index++;
+                }
+            }
+        }
+        return coordinates;
+    }
+
+    template <size_t Rows, size_t Columns>
+    static constexpr size_t CountNeighbours(const int (&bitmap)[Rows][Columns])
+    {
+        size_t count = 0;
+        for (size_t row = 0; row < Rows; row++) {
+            for (size_t column = 0; column < Columns; column++) {
+                if (bitmap[row][column] == 1) {
+                    count++;
+                }
+            }
+        }
+        return count;
+    }
+
+    template <size_t Count>
+    static constexpr unsigned Radius(const std::array<std::pair<int, int>, Count>& coordinates)
+    {
+        unsigned radius = 0;
+        for (const auto& coordinate : coordinates) {
+            radius = std::max(radius, static_cast<unsigned>(coordinate.first < 0 ? -coordinate.first : coordinate.first));
+            radius = std::max(radius, static_cast<unsigned>(coordinate.second < 0 ? -coordinate.second : coordinate.second));
+        }
+        return radius;
+    }
+
+    /**
+     * Compiles a neighbourhood into horizontal runs, so that it can be summed
+     * in one subtraction per run from row prefix sums (see Stencil) instead of
+     * one read per neighbour. Large rings and discs have far fewer runs than
+     * neighbours.
+     *
+     * static constexpr auto runs = CreateRuns<CountRuns(coordinates)>(coordinates);
+     */
+    template <size_t RunCount, size_t Count>
+    static constexpr std::array<Run, RunCount> CreateRuns(const std::array<std::pair<int, int>, Count>& coordinates)
+    {
+        std::array<Run, RunCount> runs{};
+        size_t index = 0;
+        int radius = static_cast<int>(Radius(coordinates));
+        for (int y = -radius; y <= radius; y++) {
+            for (int x = -radius; x <= radius; x++) {
+                if (Contains(coordinates, x, y) && !Contains(coordinates, x - 1, y)) {
+                    int lastX = x;
+                    while (Contains(coordinates, lastX + 1, y)) {
+                        lastX++;
+                    }
+                    runs[index] = Run{ y, x, lastX };
+                    index++;
+                }
+            }
+        }
+        return runs;
+    }
+
+    template <size_t Count>
+    static constexpr size_t CountRuns(const std::array<std::pair<int, int>, Count>& coordinates)
+    {
+        size_t count = 0;
+        for (const auto& coordinate : coordinates) {
+            if (!Contains(coordinates, coordinate.first - 1, coordinate.second)) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    template <size_t Count>
+    static constexpr bool Contains(const std::array<std::pair<int, int>, Count>& coordinates, int x, int y)
+    {
+        for (const auto& coordinate : coordinates) {
+            if (coordinate.first == x && coordinate.second == y) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * The furthest any coordinate reaches from the centre, horizontally or
+     * vertically.
+     */
+    static unsigned Radius(const std::vector<std::pair<int, int>>& coordinates)
+    {
+        unsigned radius = 0;
+        for (const auto& [x, y] : coordinates) {
+            radius = std::max(radius, static_cast<unsigned>(std::max(std::abs(x), std::abs(y))));
+        }
+        return radius;
+    }
 };
 
 #endif // NEIGHBOURHOOD_H
@@ -0,0 +1,378 @@
+#include "Pattern.h"
+
+#include "HashLife.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+// Bytes of an RLE file decoded at a time
+static constexpr size_t ChunkSize = 1 << 16;
+// Golly keeps RLE lines at most this long
+static constexpr size_t LineLength = 70;
+
+static std::string Trim(const std::string& text)
+{
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    return text.substr(first, text.find_last_not_of(" \t\r\n") + 1 - first);
+}
+
+static bool ParseCount(const std::string& text, uint64_t& value)
+{
+    if (text.empty() || text.size() > 18 || !std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+        return false;
+    }
+    value = std::strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+/**
+ * e.g. "x = 3, y = 3, rule = B3/S23". Golly's bounded grid suffix, e.g.
+ * ":T100,100", is dropped from the rule.
+ */
+static bool ParseHeader(const std::string& line, uint64_t& width, uint64_t& height, std::string& rule, std::string& error)
+{
+    bool hasWidth = false;
+    bool hasHeight = false;
+    size_t start = 0;
+    while (start <= line.size()) {
+        // The rule itself may contain commas, e.g. R5,C0,M1,S34..58,B34..45,NM
+        size_t end = line.find(',', start);
+        size_t equals = line.find('=', start);
+        std::string key = Trim(line.substr(start, equals == std::string::npos ? std::string::npos : equals - start));
+        if (key == "rule") {
+            rule = Trim(line.substr(equals + 1));
+            rule = rule.substr(0, rule.find(':'));
+            break;
+        }
+
+        std::string value = equals == std::string::npos || equals > end ? "" : Trim(line.substr(equals + 1, end == std::string::npos ? std::string::npos : end - equals - 1));
+        if (key == "x") {
+            hasWidth = ParseCount(value, width);
+        } else if (key == "y") {
+            hasHeight = ParseCount(value, height);
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    if (!hasWidth || !hasHeight || width > (uint64_t{ 1 } << 32) || height > (uint64_t{ 1 } << 32)) {
+        error = "expected a header line such as x = 3, y = 3, rule = B3/S23, not " + line;
+        return false;
+    }
+    return true;
+}
+
+static unsigned State(double value)
+{
+    // NaN and anything negative is dead
+    if (!(value >= 0.5)) {
+        return 0;
+    }
+    return static_cast<unsigned>(std::min(std::round(value), 255.0));
+}
+
+/**
+ * b and o for two state patterns, otherwise . for 0, A to X for 1 to 24 and
+ * pA to yO for 25 to 255.
+ */
+static std::string StateTag(unsigned state, bool multiState)
+{
+    if (!multiState) {
+        return state == 0 ? "b" : "o";
+    } else if (state == 0) {
+        return ".";
+    } else if (state <= 24) {
+        return std::string(1, static_cast<char>('A' + state - 1));
+    }
+    return { static_cast<char>('p' + ((state - 1) / 24) - 1), static_cast<char>('A' + ((state - 1) % 24)) };
+}
+
+/**
+ * Writes run length tokens, wrapping lines before they pass LineLength.
+ */
+class RleLineWriter {
+public:
+    explicit RleLineWriter(std::ostream& out)
+        : out_(out)
+    {
+    }
+
+    void Write(uint64_t count, const std::string& tag)
+    {
+        std::string token = (count > 1 ? std::to_string(count) : "") + tag;
+        if (line_.size() + token.size() > LineLength) {
+            out_ << line_ << '\n';
+            line_.clear();
+        }
+        line_ += token;
+    }
+
+    void Finish()
+    {
+        Write(1, "!");
+        out_ << line_ << '\n';
+    }
+
+private:
+    std::ostream& out_;
+    std::string line_;
+};
+
+bool Pattern::ReadRleHeader(std::istream& in, RleHeader& header, std::string& error)
+{
+    // Comments, then the header line
+    header = RleHeader();
+    bool hasHeader = false;
+    std::string line;
+    while (!hasHeader && std::getline(in, line)) {
+        line = Trim(line);
+        if (line.empty()) {
+            continue;
+        } else if (line.compare(0, 2, "#r") == 0) {
+            // XLife's rule line
+            header.rule = Trim(line.substr(2));
+        } else if (line.compare(0, 6, "#CXRLE") == 0) {
+            // Golly's extended RLE, e.g. #CXRLE Pos=0,0 Gen=100
+            size_t gen = line.find("Gen=");
+            if (gen != std::string::npos) {
+                header.generation = std::strtoull(line.c_str() + gen + 4, nullptr, 10);
+            }
+        } else if (line[0] != '#') {
+            if (!ParseHeader(line, header.width, header.height, header.rule, error)) {
+                return false;
+            }
+            hasHeader = true;
+        }
+    }
+    if (!hasHeader) {
+        error = "no x = ..., y = ... header line";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Decodes the cells following an RLE header, handing each row with a live
+ * cell to importRow, if given, as width values. False, and error says why,
+ * at the first thing wrong with them.
+ */
+static bool DecodeRle(std::istream& in, size_t width, size_t height, const std::function<void(size_t y, const double* row)>& importRow, std::string& error)
+{
+    // Only the current row is held, and only rows with live cells are imported, the rest are already dead
+    std::vector<double> row(width, 0.0);
+    bool rowAlive = false;
+    uint64_t x = 0;
+    uint64_t y = 0;
+    uint64_t count = 0;
+    char prefix = '\0';
+    bool finished = false;
+
+    auto endRows = [&](uint64_t rows) -> bool
+    {
+        if (rowAlive) {
+            if (y >= height) {
+                error = "more than y = " + std::to_string(height) + " rows";
+                return false;
+            }
+            if (importRow) {
+                importRow(y, row.data());
+            }
+            std::fill(row.begin(), row.end(), 0.0);
+            rowAlive = false;
+        }
+        y += rows;
+        x = 0;
+        return true;
+    };
+    auto run = [&](unsigned state, uint64_t length) -> bool
+    {
+        if (length > width - x) {
+            error = "row " + std::to_string(y + 1) + " is wider than x = " + std::to_string(width);
+            return false;
+        }
+        if (state != 0) {
+            std::fill_n(row.begin() + x, length, static_cast<double>(state));
+            rowAlive = true;
+        }
+        x += length;
+        return true;
+    };
+
+    std::vector<char> chunk(ChunkSize);
+    while (!finished && in) {
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        size_t read = static_cast<size_t>(in.gcount());
+        for (size_t index = 0; index < read && !finished; ++index) {
+            char c = chunk[index];
+            uint64_t length = count == 0 ? 1 : count;
+            bool ok = true;
+            if (prefix != '\0') {
+                if (c < 'A' || c > 'X' || ((prefix - 'p' + 1) * 24) + (c - 'A') + 1 > 255) {
+                    error = std::string("unknown state ") + prefix + c;
+                    return false;
+                }
+                ok = run(static_cast<unsigned>(((prefix - 'p' + 1) * 24) + (c - 'A') + 1), length);
+                prefix = '\0';
+                count = 0;
+            } else if (c >= '0' && c <= '9') {
+                if (count > (uint64_t{ 1 } << 40)) {
+                    error = "run too long";
+                    return false;
+                }
+                count = (count * 10) + static_cast<uint64_t>(c - '0');
+            } else if (c == 'b' || c == '.') {
+                ok = run(0, length);
+                count = 0;
+            } else if (c >= 'A' && c <= 'X') {
+                ok = run(static_cast<unsigned>(c - 'A' + 1), length);
+                count = 0;
+            } else if (c >= 'p' && c <= 'y') {
+                // The count carries over to the state's second letter
+                prefix = c;
+            } else if (c >= 'a' && c <= 'z') {
+                // Two state patterns sometimes use other letters than o for live cells
+                ok = run(1, length);
+                count = 0;
+            } else if (c == '$') {
+                ok = endRows(length);
+                count = 0;
+            } else if (c == '!') {
+                finished = true;
+            } else if (!std::isspace(static_cast<unsigned char>(c))) {
+                error = std::string("unexpected '") + c + "' in row " + std::to_string(y + 1);
+                return false;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        if (read == 0) {
+            break;
+        }
+    }
+    // A missing ! is forgiven
+    return endRows(0);
+}
+
+bool Pattern::ReadRleCells(std::istream& in, const RleHeader& header, Automaton& automaton, std::string& error)
+{
+    size_t width = header.width;
+    size_t height = header.height;
+    size_t gridWidth = std::max<size_t>(automaton.Width(), width);
+    size_t gridHeight = std::max<size_t>(automaton.Height(), height);
+    if (gridWidth > MaxSide || gridHeight > MaxSide || uint64_t{ gridWidth } * gridHeight > MaxCells) {
+        error = "x = " + std::to_string(width) + ", y = " + std::to_string(height) + " is too large a pattern";
+        return false;
+    }
+
+    // A first pass only checks the cells, so that a bad pattern leaves the automaton alone
+    std::streampos start = in.tellg();
+    if (start == std::streampos(-1)) {
+        error = "couldn't rewind the pattern";
+        return false;
+    }
+    if (!DecodeRle(in, width, height, nullptr, error)) {
+        return false;
+    }
+    in.clear();
+    if (!in.seekg(start)) {
+        error = "couldn't rewind the pattern";
+        return false;
+    }
+
+    size_t offsetX = (gridWidth - width) / 2;
+    size_t offsetY = (gridHeight - height) / 2;
+    automaton.Reset(gridWidth, gridHeight);
+    std::vector<double> gridRow(gridWidth, 0.0);
+    auto importRow = [&](size_t y, const double* row)
+    {
+        std::copy_n(row, width, gridRow.begin() + offsetX);
+        automaton.ImportRow(offsetY + y, gridRow.data());
+    };
+    if (!DecodeRle(in, width, height, importRow, error)) {
+        return false;
+    }
+
+    automaton.SetGeneration(header.generation);
+    return true;
+}
+
+bool Pattern::WriteRle(std::ostream& out, const Automaton& automaton, const std::string& rule)
+{
+    size_t width = automaton.Width();
+    size_t height = automaton.Height();
+    std::vector<double> row(width);
+
+    // A pass just for the highest state, as two state patterns are written with b and o
+    bool multiState = false;
+    if (automaton.Format() != Automaton::CellFormat::Bits) {
+        for (size_t y = 0; y < height && !multiState; ++y) {
+            automaton.ExportRow(y, row.data());
+            multiState = std::any_of(row.begin(), row.end(), [](double value) { return State(value) > 1; });
+        }
+    }
+
+    out << "#CXRLE Pos=0,0 Gen=" << automaton.Generation() << '\n';
+    out << "x = " << width << ", y = " << height;
+    if (!rule.empty()) {
+        out << ", rule = " << rule;
+    }
+    out << '\n';
+
+    // Row ends are only written once the next row with a live cell is, so trailing dead rows are left out
+    RleLineWriter writer(out);
+    uint64_t rowEnds = 0;
+    for (size_t y = 0; y < height; ++y) {
+        automaton.ExportRow(y, row.data());
+        size_t end = width;
+        while (end > 0 && State(row[end - 1]) == 0) {
+            --end;
+        }
+        if (end > 0) {
+            if (rowEnds > 0) {
+                writer.Write(rowEnds, "$");
+            }
+            for (size_t x = 0; x < end;) {
+                unsigned state = State(row[x]);
+                size_t runEnd = x + 1;
+                while (runEnd < end && State(row[runEnd]) == state) {
+                    ++runEnd;
+                }
+                writer.Write(runEnd - x, StateTag(state, multiState));
+                x = runEnd;
+            }
+            rowEnds = 0;
+        }
+        ++rowEnds;
+    }
+    writer.Finish();
+    return static_cast<bool>(out);
+}
+
+bool Pattern::WriteMacrocell(std::ostream& out, const Automaton& automaton, const std::string& rule)
+{
+    out << "[M2] (CellularAutomata)\n";
+    if (!rule.empty()) {
+        out << "#R " << rule << '\n';
+    }
+    out << "#G " << automaton.Generation() << '\n';
+
+    // Only for the tree, rather than kept by the automaton as Cells() would
+    Grid<double> cells(automaton.Width(), automaton.Height());
+    for (size_t y = 0; y < automaton.Height(); ++y) {
+        automaton.ExportRow(y, cells.Row(y));
+    }
+    HashLife tree;
+    tree.Import(cells);
+    tree.WriteMacrocell(out);
+    return static_cast<bool>(out);
+}
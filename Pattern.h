@@ -0,0 +1,60 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include "Automaton.h"
+
+#include <iostream>
+#include <string>
+#include <stdint.h>
+
+/**
+ * Reads and writes patterns in the formats Golly and other Life software use.
+ * Both directions stream, a row of cells at a time, so a pattern file is
+ * never held in memory as text or as a list of cells.
+ */
+class Pattern {
+public:
+    struct RleHeader {
+        uint64_t width = 0;
+        uint64_t height = 0;
+        // Empty if the pattern doesn't say
+        std::string rule;
+        uint64_t generation = 0;
+    };
+
+    // Grids larger than these aren't read into, whatever a pattern's header says
+    static constexpr uint64_t MaxSide = uint64_t{ 1 } << 24;
+    static constexpr uint64_t MaxCells = uint64_t{ 1 } << 30;
+
+    /**
+     * Run length encoded, including Golly's extended RLE for up to 256
+     * states, in two steps so that the pattern's rule can be set before its
+     * cells are read into whichever engine the rule uses. False, and error
+     * says why, if the pattern couldn't be read.
+     *
+     * Reading the header leaves the stream at the first line of cells.
+     */
+    static bool ReadRleHeader(std::istream& in, RleHeader& header, std::string& error);
+    /**
+     * The automaton is reset to at least the pattern's size, keeping its
+     * current size if that is larger, and the pattern is centred in it. The
+     * rest of the file is decoded a chunk at a time, once to check it and
+     * then again straight into the cells, so in must be seekable. The
+     * automaton is left alone if the pattern is too large, see MaxCells, or
+     * can't be read.
+     */
+    static bool ReadRleCells(std::istream& in, const RleHeader& header, Automaton& automaton, std::string& error);
+    /**
+     * The whole grid, so that reading it back restores its size. Cells are
+     * rounded to the nearest state from 0 to 255, and only grids with a state
+     * above 1 are written with Golly's multi-state letters.
+     */
+    static bool WriteRle(std::ostream& out, const Automaton& automaton, const std::string& rule);
+    /**
+     * Golly's macrocell format, a quadtree with every distinct square written
+     * once, see HashLife. Any non-zero cell is alive.
+     */
+    static bool WriteMacrocell(std::ostream& out, const Automaton& automaton, const std::string& rule);
+};
+
+#endif // PATTERN_H
@@ -0,0 +1,101 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <type_traits>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * A counter based random number generator, Philox4x32-10 (Salmon et al,
+ * "Parallel Random Numbers: As Easy as 1, 2, 3"). Rather than stepping some
+ * hidden state, every number is a pure function of a key, i.e. the seed, and
+ * a counter, e.g. the index of a cell. There is no state to share, so any
+ * thread can generate any part of a sequence, in any order, and get exactly
+ * the numbers it would have got generating the whole sequence serially.
+ *
+ * The stream is the high half of the 128 bit counter, for when a single index
+ * needs several independent numbers.
+ */
+class Philox {
+public:
+    using Block = std::array<uint32_t, 4>;
+
+    static Block Generate(uint64_t key, uint64_t counter, uint64_t stream = 0)
+    {
+        Block block = { Low(counter), High(counter), Low(stream), High(stream) };
+        uint32_t key0 = Low(key);
+        uint32_t key1 = High(key);
+        for (unsigned round = 0; round < 10; ++round) {
+            uint64_t product0 = uint64_t{ 0xD2511F53 } * block[0];
+            uint64_t product1 = uint64_t{ 0xCD9E8D57 } * block[2];
+            block = { High(product1) ^ block[1] ^ key0, Low(product1), High(product0) ^ block[3] ^ key1, Low(product0) };
+            key0 += 0x9E3779B9;
+            key1 += 0xBB67AE85;
+        }
+        return block;
+    }
+
+    static uint64_t Bits(uint64_t key, uint64_t counter, uint64_t stream = 0)
+    {
+        Block block = Generate(key, counter, stream);
+        return (uint64_t{ block[1] } << 32) | block[0];
+    }
+
+    /**
+     * Like Random::Number, integers are from min to max inclusive, reals from
+     * min up to but excluding max.
+     */
+    template <typename NumericType>
+    static NumericType Number(uint64_t key, uint64_t counter, NumericType min, NumericType max, uint64_t stream = 0)
+    {
+        return ToNumber(Bits(key, counter, stream), min, max);
+    }
+
+    static double Gaussian(uint64_t key, uint64_t counter, double mean, double standardDeviation, uint64_t stream = 0)
+    {
+        // Box-Muller, from the two halves of one block. one is never 0.0, so its log is finite
+        Block block = Generate(key, counter, stream);
+        double one = (static_cast<double>(((uint64_t{ block[1] } << 32) | block[0]) >> 11) + 0.5) * 0x1.0p-53;
+        double two = static_cast<double>(((uint64_t{ block[3] } << 32) | block[2]) >> 11) * 0x1.0p-53;
+        return mean + (standardDeviation * std::sqrt(-2.0 * std::log(one)) * std::cos(6.283185307179586 * two));
+    }
+
+    /**
+     * out[i] = Number(key, firstCounter + i, min, max), written straight into
+     * the buffer given.
+     */
+    template <typename NumericType, typename OutputType>
+    static void Fill(OutputType* out, size_t count, uint64_t key, uint64_t firstCounter, NumericType min, NumericType max)
+    {
+        for (size_t index = 0; index < count; ++index) {
+            out[index] = static_cast<OutputType>(ToNumber(Bits(key, firstCounter + index), min, max));
+        }
+    }
+
+private:
+    static uint32_t Low(uint64_t value) { return static_cast<uint32_t>(value); }
+    static uint32_t High(uint64_t value) { return static_cast<uint32_t>(value >> 32); }
+
+    template <typename NumericType>
+    static NumericType ToNumber(uint64_t bits, NumericType min, NumericType max)
+    {
+        if constexpr (std::is_integral<NumericType>::value) {
+            using Unsigned = std::make_unsigned_t<NumericType>;
+            // Wraps to 0 when every value of a 64 bit type is in range. The modulo bias is at most range / 2^64
+            uint64_t range = static_cast<uint64_t>(static_cast<Unsigned>(static_cast<Unsigned>(max) - static_cast<Unsigned>(min))) + 1;
+            uint64_t offset = range == 0 ? bits : bits % range;
+            return static_cast<NumericType>(static_cast<Unsigned>(static_cast<Unsigned>(min) + static_cast<Unsigned>(offset)));
+        } else if constexpr (std::is_floating_point<NumericType>::value) {
+            NumericType unit = static_cast<NumericType>(static_cast<double>(bits >> 11) * 0x1.0p-53);
+            // Rounding to float can give exactly 1.0
+            return std::min(min + ((max - min) * unit), std::nextafter(max, min));
+        } else {
+            static_assert(std::is_floating_point<NumericType>::value, "Philox::Number requires an integral OR floating point number type to work.");
+        }
+    }
+};
+
+#endif // PHILOX_H
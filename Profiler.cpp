@@ -0,0 +1,208 @@
+#include "Profiler.h"
+
+#ifdef CA_PROFILE
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+/**
+ * The events of one thread, never freed so that a thread's events outlive it.
+ */
+struct ThreadProfile {
+    size_t index = 0;
+    // Only ever contended by a reader
+    std::mutex mutex;
+    // Overwritten oldest first once full
+    std::vector<ProfileEvent> events;
+    size_t nextEvent = 0;
+    std::vector<Profiler::Summary> summaries;
+};
+
+static std::mutex& ThreadsMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<std::unique_ptr<ThreadProfile>>& Threads()
+{
+    static std::vector<std::unique_ptr<ThreadProfile>> threads;
+    return threads;
+}
+
+static ThreadProfile& ThisThread()
+{
+    thread_local ThreadProfile* profile = nullptr;
+    if (!profile) {
+        std::lock_guard lock(ThreadsMutex());
+        Threads().push_back(std::make_unique<ThreadProfile>());
+        profile = Threads().back().get();
+        profile->index = Threads().size() - 1;
+    }
+    return *profile;
+}
+
+// The same literal may have a different address in each translation unit
+static Profiler::Summary& SummaryOf(std::vector<Profiler::Summary>& summaries, const char* name)
+{
+    for (Profiler::Summary& summary : summaries) {
+        if (summary.name == name || std::strcmp(summary.name, name) == 0) {
+            return summary;
+        }
+    }
+    summaries.push_back({ name, 0, 0.0, 0.0 });
+    return summaries.back();
+}
+
+static void WriteJsonString(std::ostream& out, const char* text)
+{
+    out << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+// Exactly, as a decimal to the nanosecond, which a double's default 6 significant digits aren't
+static void WriteMicroseconds(std::ostream& out, uint64_t nanoseconds)
+{
+    std::string fraction = std::to_string(nanoseconds % 1000);
+    out << nanoseconds / 1000 << '.' << std::string(3 - fraction.size(), '0') << fraction;
+}
+
+uint64_t Profiler::Now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+    ThreadProfile& thread = ThisThread();
+    std::lock_guard lock(thread.mutex);
+    if (thread.events.size() < EventsPerThread) {
+        thread.events.push_back({ name, start, end });
+    } else {
+        thread.events[thread.nextEvent] = { name, start, end };
+        thread.nextEvent = (thread.nextEvent + 1) % EventsPerThread;
+    }
+
+    Summary& summary = SummaryOf(thread.summaries, name);
+    double seconds = static_cast<double>(end - start) * 1e-9;
+    ++summary.count;
+    summary.totalSeconds += seconds;
+    summary.lastSeconds = seconds;
+}
+
+std::vector<Profiler::Summary> Profiler::Summaries()
+{
+    std::vector<Summary> summaries;
+    std::lock_guard threadsLock(ThreadsMutex());
+    for (const std::unique_ptr<ThreadProfile>& thread : Threads()) {
+        std::lock_guard lock(thread->mutex);
+        for (const Summary& threadSummary : thread->summaries) {
+            Summary& summary = SummaryOf(summaries, threadSummary.name);
+            summary.count += threadSummary.count;
+            summary.totalSeconds += threadSummary.totalSeconds;
+            summary.lastSeconds = threadSummary.lastSeconds;
+        }
+    }
+    std::sort(summaries.begin(), summaries.end(), [](const Summary& a, const Summary& b) { return a.totalSeconds > b.totalSeconds; });
+    return summaries;
+}
+
+bool Profiler::WriteTrace(std::ostream& out, std::string& error)
+{
+    std::lock_guard threadsLock(ThreadsMutex());
+    if (Threads().empty()) {
+        error = "nothing has been profiled yet";
+        return false;
+    }
+
+    // Timestamps are from the earliest event recorded, rather than from whenever the steady clock started
+    uint64_t epoch = UINT64_MAX;
+    for (const std::unique_ptr<ThreadProfile>& thread : Threads()) {
+        std::lock_guard lock(thread->mutex);
+        for (const ProfileEvent& event : thread->events) {
+            epoch = std::min(epoch, event.start);
+        }
+    }
+
+    // Complete ("X") events, timestamps in microseconds
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const std::unique_ptr<ThreadProfile>& thread : Threads()) {
+        std::lock_guard lock(thread->mutex);
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->index
+            << ",\"args\":{\"name\":\"Thread " << thread->index << "\"}}";
+        first = false;
+        for (const ProfileEvent& event : thread->events) {
+            out << ",\n{\"name\":";
+            WriteJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->index
+                << ",\"ts\":";
+            WriteMicroseconds(out, event.start - epoch);
+            out << ",\"dur\":";
+            WriteMicroseconds(out, event.end - event.start);
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        error = "couldn't write the trace";
+        return false;
+    }
+    return true;
+}
+
+void Profiler::Clear()
+{
+    std::lock_guard threadsLock(ThreadsMutex());
+    for (const std::unique_ptr<ThreadProfile>& thread : Threads()) {
+        std::lock_guard lock(thread->mutex);
+        thread->events.clear();
+        thread->nextEvent = 0;
+        thread->summaries.clear();
+    }
+}
+
+#else
+
+uint64_t Profiler::Now()
+{
+    return 0;
+}
+
+void Profiler::Record(const char* /*name*/, uint64_t /*start*/, uint64_t /*end*/)
+{
+}
+
+std::vector<Profiler::Summary> Profiler::Summaries()
+{
+    return {};
+}
+
+bool Profiler::WriteTrace(std::ostream& /*out*/, std::string& error)
+{
+    error = "built without profiling, rebuild with CONFIG+=profile";
+    return false;
+}
+
+void Profiler::Clear()
+{
+}
+
+#endif // CA_PROFILE
@@ -0,0 +1,96 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+#include <ostream>
+#include <string>
+#include <stdint.h>
+
+/**
+ * Times the phases of stepping and painting, e.g. the step kernel, each tile
+ * of it, border refreshes and rendering, for an on screen overlay and for
+ * offline analysis as a Chrome trace (chrome://tracing or Perfetto).
+ *
+ * Only compiled in when CA_PROFILE is defined, e.g. by building with
+ * CONFIG+=profile. Otherwise PROFILE_SCOPE expands to nothing, so the phases
+ * cost nothing extra to run, and the functions below report nothing.
+ *
+ * Each thread records into its own buffers, so recording never contends with
+ * other threads, only with the occasional reader. The most recent
+ * EventsPerThread events of each thread are kept for the trace, along with a
+ * running total per scope name.
+ */
+class Profiler {
+public:
+#ifdef CA_PROFILE
+    static constexpr bool Enabled = true;
+#else
+    static constexpr bool Enabled = false;
+#endif
+    static constexpr size_t EventsPerThread = size_t(1) << 18;
+
+    struct Summary {
+        // PROFILE_SCOPE's name
+        const char* name;
+        uint64_t count;
+        double totalSeconds;
+        // The most recent of them
+        double lastSeconds;
+    };
+
+    /**
+     * Nanoseconds from an arbitrary, steady, starting point.
+     */
+    static uint64_t Now();
+    static void Record(const char* name, uint64_t start, uint64_t end);
+
+    /**
+     * Every scope name recorded so far, totalled across threads and sorted by
+     * total time, longest first.
+     */
+    static std::vector<Summary> Summaries();
+    /**
+     * The events still held, in Chrome's trace event JSON format, one row per
+     * thread. False, and error says why, if there is nothing to write.
+     */
+    static bool WriteTrace(std::ostream& out, std::string& error);
+    static void Clear();
+};
+
+#ifdef CA_PROFILE
+
+/**
+ * Records the time from its construction to its destruction.
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+        : name_(name)
+        , start_(Profiler::Now())
+    {
+    }
+    ~ProfileScope()
+    {
+        Profiler::Record(name_, start_, Profiler::Now());
+    }
+
+    ProfileScope(const ProfileScope& other) = delete;
+    ProfileScope& operator=(const ProfileScope& other) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+// name must be a string literal, only the pointer to it is kept
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+
+#else
+
+#define PROFILE_SCOPE(name)
+
+#endif // CA_PROFILE
+
+#endif // PROFILER_H
@@ -0,0 +1,63 @@
+#include "Renderer.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+
+Renderer::Renderer(Colouriser&& colouriser)
+{
+    SetColouriser(std::move(colouriser));
+}
+
+void Renderer::SetColouriser(Colouriser&& colouriser)
+{
+    colouriser_ = std::move(colouriser);
+    lut_.clear();
+    // An empty range, so every value goes through the colouriser
+    lutMin_ = 1.0;
+    lutMax_ = 0.0;
+    lutScale_ = 0.0;
+}
+
+void Renderer::SetColouriser(Colouriser&& colouriser, double min, double max)
+{
+    SetColouriser(std::move(colouriser));
+    if (!(min < max)) {
+        return;
+    }
+
+    lutMin_ = min;
+    lutMax_ = max;
+    lutScale_ = (LutSize - 1) / (max - min);
+    lut_.resize(LutSize);
+    for (size_t index = 0; index < LutSize; ++index) {
+        // Pin the ends so that min and max themselves are exact
+        double value = index == LutSize - 1 ? max : min + (index / lutScale_);
+        lut_[index] = colouriser_(value) | 0xFF000000;
+    }
+}
+
+template <typename CellType>
+void Renderer::Render(const Grid<CellType>& cells, const Tile& region, uint32_t* pixels, ptrdiff_t pixelsPerLine, ThreadPool& threads) const
+{
+    PROFILE_SCOPE("Render");
+    size_t height = region.lastY - region.firstY;
+    size_t bandCount = (height + BandHeight - 1) / BandHeight;
+    threads.ParallelFor(bandCount, [&](size_t band)
+    {
+        PROFILE_SCOPE("Render band");
+        size_t firstRow = band * BandHeight;
+        size_t lastRow = std::min(height, firstRow + BandHeight);
+        for (size_t row = firstRow; row < lastRow; ++row) {
+            const CellType* cellRow = cells.Row(region.firstY + row);
+            uint32_t* pixelRow = pixels + (static_cast<ptrdiff_t>(row) * pixelsPerLine);
+            for (size_t x = region.firstX; x < region.lastX; ++x) {
+                *pixelRow++ = Colour(static_cast<double>(cellRow[x]));
+            }
+        }
+    });
+}
+
+template void Renderer::Render(const Grid<uint8_t>& cells, const Tile& region, uint32_t* pixels, ptrdiff_t pixelsPerLine, ThreadPool& threads) const;
+template void Renderer::Render(const Grid<float>& cells, const Tile& region, uint32_t* pixels, ptrdiff_t pixelsPerLine, ThreadPool& threads) const;
+template void Renderer::Render(const Grid<double>& cells, const Tile& region, uint32_t* pixels, ptrdiff_t pixelsPerLine, ThreadPool& threads) const;
@@ -0,0 +1,60 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "Grid.h"
+#include "Stencil.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+/**
+ * Converts cells into 32 bit 0xFFRRGGBB pixels, e.g. the scanlines of a
+ * QImage::Format_RGB32 image. Rows are converted in parallel.
+ *
+ * A colouriser given a range is sampled into a lookup table once, so values
+ * inside that range cost an index calculation rather than a std::function
+ * call. This quantises the colouriser to LutSize steps across the range,
+ * values outside of it still go through the colouriser.
+ */
+class Renderer {
+public:
+    using Colouriser = std::function<unsigned(const double& value)>;
+
+    static constexpr size_t LutSize = 4096;
+
+    Renderer(Colouriser&& colouriser);
+
+    void SetColouriser(Colouriser&& colouriser);
+    void SetColouriser(Colouriser&& colouriser, double min, double max);
+
+    /**
+     * Writes the region of cells into pixels, cell (region.firstX,
+     * region.firstY) going to pixels[0]. pixelsPerLine is the distance between
+     * rows of pixels. Instantiated for uint8_t, float and double cells, each
+     * is coloured as the double of the same value.
+     */
+    template <typename CellType>
+    void Render(const Grid<CellType>& cells, const Tile& region, uint32_t* pixels, ptrdiff_t pixelsPerLine, ThreadPool& threads) const;
+
+private:
+    // Rows handed to a thread at once
+    static constexpr size_t BandHeight = 16;
+
+    Colouriser colouriser_;
+    std::vector<uint32_t> lut_;
+    double lutMin_;
+    double lutMax_;
+    double lutScale_;
+
+    uint32_t Colour(double value) const
+    {
+        if (value >= lutMin_ && value <= lutMax_) {
+            return lut_[static_cast<size_t>(((value - lutMin_) * lutScale_) + 0.5)];
+        }
+        return colouriser_(value) | 0xFF000000;
+    }
+};
+
+#endif // RENDERER_H
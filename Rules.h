@@ -0,0 +1,236 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "Neighbourhood.h"
+#include "NeuralNetwork.h"
+#include "Stencil.h"
+
+#include <memory>
+#include <stdint.h>
+
+/*
+ * The built in rules, as functors for CellularAutomata::SetCellRule. Each
+ * rule's neighbourhood is a compile time constant so that the kernel
+ * instantiated for it has every neighbour offset baked in, and each declares
+ * the smallest CellType its states fit in.
+ */
+
+/**
+ * Conways game of life, evaluated cell by cell. LifeRule::Conway() is the
+ * same rule for the much faster bit-packed LifeEngine.
+ */
+struct ConwayRule {
+    static constexpr int Bitmap[3][3] = {
+        { 1, 1, 1 },
+        { 1, 0, 1 },
+        { 1, 1, 1 },
+    };
+    static constexpr auto Coordinates = Neighbourhood::CreateNeighbourhoodCoordinates<Neighbourhood::CountNeighbours(Bitmap)>(Bitmap);
+    static constexpr unsigned Radius = Neighbourhood::Radius(Coordinates);
+
+    using CellType = uint8_t;
+
+    CellType operator()(const Neighbours<CellType>& cell) const
+    {
+        int neighbours = cell.Sum(Coordinates);
+        if (neighbours == 3 || (cell(0, 0) != 0 && neighbours == 2)) {
+            return 1;
+        } else {
+            return 0;
+        }
+    }
+};
+
+/**
+ * Feeds the eight surrounding cells into a network and mixes two of its
+ * outputs with the current value. Each row of a tile goes through the network
+ * as one batch, rather than one cell at a time. Scalar is the network's, see
+ * NeuralNetwork, and the cells are stored as Scalar too.
+ */
+template <typename Scalar>
+struct NeuralNetRule {
+    // In the order they are fed into the network
+    static constexpr int Bitmap[3][3] = {
+        { 1, 1, 1 },
+        { 1, 0, 1 },
+        { 1, 1, 1 },
+    };
+    static constexpr auto Coordinates = Neighbourhood::CreateNeighbourhoodCoordinates<Neighbourhood::CountNeighbours(Bitmap)>(Bitmap);
+    static constexpr unsigned Radius = Neighbourhood::Radius(Coordinates);
+    static constexpr bool StepsTiles = true;
+
+    using CellType = Scalar;
+
+    std::shared_ptr<const NeuralNetwork<Scalar>> network;
+
+    void StepTile(const Grid<CellType>& cells, Grid<CellType>& nextCells, const Tile& tile) const
+    {
+        assert(network->GetInputCount() == Coordinates.size() && network->GetOutputCount() > 4);
+        size_t inputCount = Coordinates.size();
+        size_t outputCount = network->GetOutputCount();
+        size_t width = tile.lastX - tile.firstX;
+
+        std::vector<Scalar> inputs(width * inputCount);
+        std::vector<Scalar> outputs(width * outputCount);
+        std::vector<Scalar> scratch;
+        ptrdiff_t stride = cells.Stride();
+        for (size_t y = tile.firstY; y < tile.lastY; y++) {
+            const CellType* row = cells.Row(y);
+            Scalar* input = inputs.data();
+            for (size_t x = tile.firstX; x < tile.lastX; x++) {
+                Neighbours<CellType> cell(row + x, stride);
+                for (const auto& [xOffset, yOffset] : Coordinates) {
+                    *input++ = cell(xOffset, yOffset);
+                }
+            }
+
+            network->ForwardPropogate(inputs.data(), outputs.data(), width, scratch);
+
+            CellType* nextRow = nextCells.Row(y);
+            const Scalar* output = outputs.data();
+            for (size_t x = tile.firstX; x < tile.lastX; x++) {
+                nextRow[x] = (output[0] + output[4] + row[x]) / Scalar{ 3 };
+                output += outputCount;
+            }
+        }
+    }
+};
+
+/**
+ * Several large rings and discs, each with its own thresholds that turn a
+ * cell on or off. Hundreds of neighbours in all, so the neighbourhoods are
+ * summed as runs from prefix sums, see Stencil::StepWithRunSums.
+ */
+struct MultipleNeighbourhoodsRule {
+    static constexpr int Bitmap1[29][29] = {
+        { 0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0, },
+        { 0,0,0,0,0,1,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,1,0,0,0,0,0, },
+        { 0,0,0,0,1,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,1,0,0,0,0, },
+        { 0,0,0,1,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,1,0,0,0, },
+        { 0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0, },
+        { 0,0,1,0,0,0,1,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,1,0,0,0,1,0,0, },
+        { 0,0,1,0,0,0,1,0,0,1,0,0,0,1,1,1,0,0,0,1,0,0,1,0,0,0,1,0,0, },
+        { 0,1,0,0,0,1,0,0,1,0,0,1,1,0,0,0,1,1,0,0,1,0,0,1,0,0,0,1,0, },
+        { 0,1,0,0,0,1,0,0,1,0,1,0,0,1,1,1,0,0,1,0,1,0,0,1,0,0,0,1,0, },
+        { 0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0, },
+        { 1,0,0,0,1,0,0,1,0,1,0,1,0,1,1,1,0,1,0,1,0,1,0,0,1,0,0,0,1, },
+        { 1,0,0,0,1,0,0,1,0,1,0,1,0,1,1,1,0,1,0,1,0,1,0,0,1,0,0,0,1, },
+        { 1,0,0,0,1,0,0,1,0,1,0,1,0,1,1,1,0,1,0,1,0,1,0,0,1,0,0,0,1, },
+        { 0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0,1,0,0,1,0,1,0,0,0,1,0, },
+        { 0,1,0,0,0,1,0,0,1,0,1,0,0,1,1,1,0,0,1,0,1,0,0,1,0,0,0,1,0, },
+        { 0,1,0,0,0,1,0,0,1,0,0,1,1,0,0,0,1,1,0,0,1,0,0,1,0,0,0,1,0, },
+        { 0,0,1,0,0,0,1,0,0,1,0,0,0,1,1,1,0,0,0,1,0,0,1,0,0,0,1,0,0, },
+        { 0,0,1,0,0,0,1,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,1,0,0,0,1,0,0, },
+        { 0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0, },
+        { 0,0,0,1,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,1,0,0,0, },
+        { 0,0,0,0,1,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,1,0,0,0,0, },
+        { 0,0,0,0,0,1,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,1,0,0,0,0,0, },
+        { 0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0, },
+    };
+    static constexpr int Bitmap2[7][7] = {
+        { 0,0,1,1,1,0,0, },
+        { 0,1,0,0,0,1,0, },
+        { 1,0,1,1,1,0,1, },
+        { 1,0,1,0,1,0,1, },
+        { 1,0,1,1,1,0,1, },
+        { 0,1,0,0,0,1,0, },
+        { 0,0,1,1,1,0,0, },
+    };
+    static constexpr int Bitmap3[13][13] = {
+        { 0,0,0,0,0,1,1,1,0,0,0,0,0 },
+        { 0,0,0,1,1,1,1,1,1,1,0,0,0 },
+        { 0,0,1,1,1,1,1,1,1,1,1,0,0 },
+        { 0,1,1,1,1,0,0,0,1,1,1,1,0 },
+        { 0,1,1,1,0,0,0,0,0,1,1,1,0 },
+        { 1,1,1,0,0,0,0,0,0,0,1,1,1 },
+        { 1,1,1,0,0,0,0,0,0,0,1,1,1 },
+        { 1,1,1,0,0,0,0,0,0,0,1,1,1 },
+        { 0,1,1,1,0,0,0,0,0,1,1,1,0 },
+        { 0,1,1,1,1,0,0,0,1,1,1,1,0 },
+        { 0,0,1,1,1,1,1,1,1,1,1,0,0 },
+        { 0,0,0,1,1,1,1,1,1,1,0,0,0 },
+        { 0,0,0,0,0,1,1,1,0,0,0,0,0 },
+    };
+    static constexpr int Bitmap4[29][29] = {
+        { 0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0, },
+        { 0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0, },
+        { 0,0,0,0,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,0,0,0,0, },
+        { 0,0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0,0, },
+        { 0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0, },
+        { 0,0,1,1,1,1,0,0,0,0,0,0,1,1,1,1,1,0,0,0,0,0,0,1,1,1,1,0,0, },
+        { 0,1,1,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,1,1,0, },
+        { 0,1,1,1,1,0,0,0,0,1,0,0,0,0,0,0,0,0,0,1,0,0,0,0,1,1,1,1,0, },
+        { 0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0, },
+        { 1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1, },
+        { 1,1,1,1,0,0,0,1,0,0,0,1,0,0,0,0,0,1,0,0,0,1,0,0,0,1,1,1,1, },
+        { 1,1,1,1,0,0,0,1,0,0,1,0,0,1,1,1,0,0,1,0,0,1,0,0,0,1,1,1,1, },
+        { 1,1,1,1,0,0,0,1,0,0,1,0,0,1,0,1,0,0,1,0,0,1,0,0,0,1,1,1,1, },
+        { 1,1,1,1,0,0,0,1,0,0,1,0,0,1,1,1,0,0,1,0,0,1,0,0,0,1,1,1,1, },
+        { 1,1,1,1,0,0,0,1,0,0,0,1,0,0,0,0,0,1,0,0,0,1,0,0,0,1,1,1,1, },
+        { 1,1,1,1,0,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,0,1,1,1,1, },
+        { 0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0,0,0,0,1,0,0,0,0,1,1,1,0, },
+        { 0,1,1,1,1,0,0,0,0,1,0,0,0,0,0,0,0,0,0,1,0,0,0,0,1,1,1,1,0, },
+        { 0,1,1,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,0,0,0,0,0,1,1,1,1,0, },
+        { 0,0,1,1,1,1,0,0,0,0,0,0,1,1,1,1,1,0,0,0,0,0,0,1,1,1,1,0,0, },
+        { 0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0, },
+        { 0,0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0,0, },
+        { 0,0,0,0,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,0,0,0,0, },
+        { 0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0, },
+        { 0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0, },
+        { 0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0, },
+    };
+    static constexpr auto Coordinates1 = Neighbourhood::CreateNeighbourhoodCoordinates<Neighbourhood::CountNeighbours(Bitmap1)>(Bitmap1);
+    static constexpr auto Coordinates2 = Neighbourhood::CreateNeighbourhoodCoordinates<Neighbourhood::CountNeighbours(Bitmap2)>(Bitmap2);
+    static constexpr auto Coordinates3 = Neighbourhood::CreateNeighbourhoodCoordinates<Neighbourhood::CountNeighbours(Bitmap3)>(Bitmap3);
+    static constexpr auto Coordinates4 = Neighbourhood::CreateNeighbourhoodCoordinates<Neighbourhood::CountNeighbours(Bitmap4)>(Bitmap4);
+    static constexpr unsigned Radius = std::max({ Neighbourhood::Radius(Coordinates1), Neighbourhood::Radius(Coordinates2), Neighbourhood::Radius(Coordinates3), Neighbourhood::Radius(Coordinates4) });
+
+    static constexpr auto Runs1 = Neighbourhood::CreateRuns<Neighbourhood::CountRuns(Coordinates1)>(Coordinates1);
+    static constexpr auto Runs2 = Neighbourhood::CreateRuns<Neighbourhood::CountRuns(Coordinates2)>(Coordinates2);
+    static constexpr auto Runs3 = Neighbourhood::CreateRuns<Neighbourhood::CountRuns(Coordinates3)>(Coordinates3);
+    static constexpr auto Runs4 = Neighbourhood::CreateRuns<Neighbourhood::CountRuns(Coordinates4)>(Coordinates4);
+    static constexpr bool SumsRuns = true;
+
+    using CellType = uint8_t;
+
+    template <typename Cell>
+    CellType operator()(const Cell& cell) const
+    {
+        int neighbours1 = cell.Sum(Runs1);
+        int neighbours2 = cell.Sum(Runs2);
+        int neighbours3 = cell.Sum(Runs3);
+        int neighbours4 = cell.Sum(Runs4);
+
+        CellType value = cell(0, 0);
+        if (neighbours1 >= 0 && neighbours1 <= 17) {
+            value = 0;
+        }
+        if (neighbours1 >= 40 && neighbours1 <= 42) {
+            value = 1;
+        }
+        if (neighbours2 >= 10 && neighbours2 <= 13) {
+            value = 1;
+        }
+        if (neighbours3 >= 9 && neighbours3 <= 21) {
+            value = 0;
+        }
+        if (neighbours4 >= 78 && neighbours4 <= 89) {
+            value = 0;
+        }
+        if (neighbours4 > 108) {
+            value = 0;
+        }
+        return value;
+    }
+};
+
+#endif // RULES_H
@@ -0,0 +1,251 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include "Grid.h"
+#include "Neighbourhood.h"
+#include "CellHash.h"
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+/**
+ * A rectangle of interior cells, [firstX, lastX) by [firstY, lastY).
+ */
+struct Tile {
+    size_t firstX;
+    size_t lastX;
+    size_t firstY;
+    size_t lastY;
+};
+
+/**
+ * What sums of cells are accumulated in. Small integer cells are promoted, so
+ * that summing hundreds of uint8_t neighbours doesn't overflow.
+ */
+template <typename CellType>
+using SumType = decltype(CellType{} + CellType{});
+
+/**
+ * What a rule sees of the grid, the cell being stepped and everything within
+ * the grid's border of it. Reads are a single offset load, so a rule that
+ * calls this with constant offsets compiles down to plain array accesses.
+ */
+template <typename CellType>
+class Neighbours {
+public:
+    Neighbours(const CellType* centre, ptrdiff_t stride)
+        : centre_(centre)
+        , stride_(stride)
+    {
+    }
+
+    const CellType& operator()(int xOffset, int yOffset) const
+    {
+        return centre_[(yOffset * stride_) + xOffset];
+    }
+
+    template <size_t Count>
+    SumType<CellType> Sum(const std::array<std::pair<int, int>, Count>& coordinates) const
+    {
+        SumType<CellType> sum{};
+        for (const auto& [xOffset, yOffset] : coordinates) {
+            sum += (*this)(xOffset, yOffset);
+        }
+        return sum;
+    }
+
+    template <size_t Count>
+    SumType<CellType> Sum(const std::array<Neighbourhood::Run, Count>& runs) const
+    {
+        SumType<CellType> sum{};
+        for (const auto& run : runs) {
+            const CellType* row = centre_ + (run.yOffset * stride_);
+            for (int x = run.firstX; x <= run.lastX; x++) {
+                sum += row[x];
+            }
+        }
+        return sum;
+    }
+
+private:
+    const CellType* centre_;
+    ptrdiff_t stride_;
+};
+
+/**
+ * Neighbours for rules that sum neighbourhoods compiled into runs. Alongside
+ * the cells it has the running total along each row, so a run of any length
+ * sums with a single subtraction.
+ */
+template <typename CellType>
+class RunSums {
+public:
+    RunSums(const CellType* centre, ptrdiff_t stride, const SumType<CellType>* prefixSums, ptrdiff_t prefixStride)
+        : cells_(centre, stride)
+        , prefixSums_(prefixSums)
+        , prefixStride_(prefixStride)
+    {
+    }
+
+    const CellType& operator()(int xOffset, int yOffset) const
+    {
+        return cells_(xOffset, yOffset);
+    }
+
+    template <size_t Count>
+    SumType<CellType> Sum(const std::array<std::pair<int, int>, Count>& coordinates) const
+    {
+        return cells_.Sum(coordinates);
+    }
+
+    template <size_t Count>
+    SumType<CellType> Sum(const std::array<Neighbourhood::Run, Count>& runs) const
+    {
+        SumType<CellType> sum{};
+        for (const auto& run : runs) {
+            const SumType<CellType>* row = prefixSums_ + (run.yOffset * prefixStride_);
+            sum += row[run.lastX + 1] - row[run.firstX];
+        }
+        return sum;
+    }
+
+private:
+    Neighbours<CellType> cells_;
+    // Points at the sum of the centre's row up to, but not including, the centre
+    const SumType<CellType>* prefixSums_;
+    ptrdiff_t prefixStride_;
+};
+
+class Stencil {
+private:
+    template <typename Rule, typename = void>
+    struct SumsRuns : std::false_type {};
+    template <typename Rule>
+    struct SumsRuns<Rule, std::void_t<decltype(Rule::SumsRuns)>> : std::bool_constant<Rule::SumsRuns> {};
+    template <typename Rule, typename = void>
+    struct StepsTiles : std::false_type {};
+    template <typename Rule>
+    struct StepsTiles<Rule, std::void_t<decltype(Rule::StepsTiles)>> : std::bool_constant<Rule::StepsTiles> {};
+
+public:
+    /**
+     * The type a rule's cells are stored as, its "using CellType = ..." if it
+     * has one, otherwise double.
+     */
+    template <typename Rule, typename = void>
+    struct CellTypeOf {
+        using type = double;
+    };
+    template <typename Rule>
+    struct CellTypeOf<Rule, std::void_t<typename Rule::CellType>> {
+        using type = typename Rule::CellType;
+    };
+
+    /**
+     * Applies rule to every cell of tile in cells, writing the results into
+     * the same tile of nextCells. Instantiated per rule, so that the rule is
+     * inlined into the loop rather than called through a std::function.
+     *
+     * Rule needs a "static constexpr unsigned Radius" no smaller than its
+     * furthest neighbour and a call operator taking Neighbours<CellType>.
+     * Rules that set "static constexpr bool SumsRuns = true" are passed
+     * RunSums<CellType> instead, and each tile gets its row prefix sums
+     * computed up front. Rules that set "static constexpr bool StepsTiles =
+     * true" step whole tiles themselves, through
+     * "void StepTile(cells, nextCells, tile) const", for rules that are
+     * cheaper to evaluate many cells at a time.
+     */
+    template <typename Rule, typename CellType>
+    static void Step(const Rule& rule, const Grid<CellType>& cells, Grid<CellType>& nextCells, const Tile& tile)
+    {
+        if constexpr (StepsTiles<Rule>::value) {
+            rule.StepTile(cells, nextCells, tile);
+        } else if constexpr (SumsRuns<Rule>::value) {
+            StepWithRunSums(rule, cells, nextCells, tile);
+        } else {
+            ptrdiff_t stride = cells.Stride();
+            for (size_t y = tile.firstY; y < tile.lastY; y++) {
+                const CellType* row = cells.Row(y);
+                CellType* nextRow = nextCells.Row(y);
+                for (size_t x = tile.firstX; x < tile.lastX; x++) {
+                    nextRow[x] = rule(Neighbours<CellType>(row + x, stride));
+                }
+            }
+        }
+    }
+
+    template <typename Rule, typename CellType>
+    static void StepWithRunSums(const Rule& rule, const Grid<CellType>& cells, Grid<CellType>& nextCells, const Tile& tile)
+    {
+        // Prefix sums cover the tile plus the rule's reach, with one extra column for the end of the last run
+        ptrdiff_t radius = static_cast<ptrdiff_t>(Rule::Radius);
+        ptrdiff_t firstX = static_cast<ptrdiff_t>(tile.firstX) - radius;
+        ptrdiff_t firstY = static_cast<ptrdiff_t>(tile.firstY) - radius;
+        ptrdiff_t prefixStride = static_cast<ptrdiff_t>(tile.lastX - tile.firstX) + (2 * radius) + 1;
+        ptrdiff_t prefixRows = static_cast<ptrdiff_t>(tile.lastY - tile.firstY) + (2 * radius);
+
+        thread_local std::vector<SumType<CellType>> prefixSums;
+        prefixSums.resize(prefixStride * prefixRows);
+        for (ptrdiff_t row = 0; row < prefixRows; row++) {
+            const CellType* cellRow = cells.Row(firstY + row) + firstX;
+            SumType<CellType>* prefixRow = prefixSums.data() + (row * prefixStride);
+            SumType<CellType> total{};
+            prefixRow[0] = total;
+            for (ptrdiff_t column = 1; column < prefixStride; column++) {
+                total += cellRow[column - 1];
+                prefixRow[column] = total;
+            }
+        }
+
+        ptrdiff_t stride = cells.Stride();
+        for (size_t y = tile.firstY; y < tile.lastY; y++) {
+            const CellType* row = cells.Row(y);
+            CellType* nextRow = nextCells.Row(y);
+            const SumType<CellType>* prefixRow = prefixSums.data() + ((static_cast<ptrdiff_t>(y) - firstY) * prefixStride) - firstX;
+            for (size_t x = tile.firstX; x < tile.lastX; x++) {
+                nextRow[x] = rule(RunSums<CellType>(row + x, stride, prefixRow + x, prefixStride));
+            }
+        }
+    }
+
+    /**
+     * True if any cell of tile has a different value in the two grids.
+     * hashChange is XORed with the change to the grid's CellHash, the
+     * position of a cell being y * Width() + x.
+     */
+    template <typename CellType>
+    static bool Differs(const Grid<CellType>& cells, const Grid<CellType>& nextCells, const Tile& tile, uint64_t& hashChange)
+    {
+        bool differs = false;
+        for (size_t y = tile.firstY; y < tile.lastY; y++) {
+            differs |= RowDiffers(cells.Row(y) + tile.firstX, nextCells.Row(y) + tile.firstX, tile.lastX - tile.firstX, (y * cells.Width()) + tile.firstX, hashChange);
+        }
+        return differs;
+    }
+
+    /**
+     * As Differs, for count cells of a row, the first being at position.
+     */
+    template <typename CellType>
+    static bool RowDiffers(const CellType* row, const CellType* nextRow, size_t count, uint64_t position, uint64_t& hashChange)
+    {
+        bool differs = false;
+        for (size_t x = 0; x < count; x++) {
+            differs |= row[x] != nextRow[x];
+        }
+        if (!differs) {
+            return false;
+        }
+        // Only rows that changed are hashed, so settled tiles cost no more than the comparison
+        for (size_t x = 0; x < count; x++) {
+            if (row[x] != nextRow[x]) {
+                hashChange ^= CellHash::Of(position + x, CellHash::Bits(row[x])) ^ CellHash::Of(position + x, CellHash::Bits(nextRow[x]));
+            }
+        }
+        return true;
+    }
+};
+
+#endif // STENCIL_H
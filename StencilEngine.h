@@ -0,0 +1,432 @@
+#ifndef STENCILENGINE_H
+#define STENCILENGINE_H
+
+#include "Grid.h"
+#include "Stencil.h"
+#include "ThreadPool.h"
+#include "ActiveTiles.h"
+#include "Philox.h"
+#include "CellHash.h"
+#include "Profiler.h"
+
+#include <functional>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <cmath>
+#include <stdint.h>
+#include <assert.h>
+
+/**
+ * Steps a rule cell by cell, on cells stored as CellType. Discrete rules keep
+ * their cells as uint8_t and continuous ones as float, so a cell costs 1 or 4
+ * bytes of memory and bandwidth rather than 8, see Stencil::CellTypeOf.
+ *
+ * Cells are stepped in square tiles, one task per tile, and a tile is only
+ * recomputed when something within reach of it changed in the previous
+ * generation, see ActiveTiles.
+ *
+ * Cells are imported and exported as doubles, integer cell types round them
+ * to the nearest value they can hold.
+ *
+ * A CellHash of the cells is kept up to date by each step, from only the
+ * cells that changed. It is only recomputed from scratch by the first step
+ * after the cells are written to from outside.
+ *
+ * Grids too large for the cache have to be streamed through memory once per
+ * generation, so a cheap enough rule on enough threads is bound by memory
+ * bandwidth rather than by the rule. StepBlock() instead steps each block of
+ * tiles several generations on while it is in cache, see BlockGenerations().
+ */
+template <typename CellType>
+class StencilEngine {
+public:
+    using TileStepper = std::function<void(const Grid<CellType>& cells, Grid<CellType>& nextCells, const Tile& tile)>;
+
+    size_t Width() const { return cells_.Width(); }
+    size_t Height() const { return cells_.Height(); }
+
+    const Grid<CellType>& Cells() const { return cells_; }
+
+    /**
+     * The radius is the furthest the stepper reads from the cell it steps.
+     */
+    void SetTileStepper(TileStepper&& stepper, unsigned radius)
+    {
+        stepTile_ = std::move(stepper);
+        cells_.SetBorder(radius);
+        nextCells_.SetBorder(radius);
+        activeTiles_.MarkAllChanged();
+        ChooseBlocks(radius);
+    }
+
+    void Step(ThreadPool& threads)
+    {
+        size_t width = cells_.Width();
+        size_t height = cells_.Height();
+        size_t tileColumns = ResizeTiles();
+
+        // Once per generation, so the stepper can read past the edges without wrapping each access
+        {
+            PROFILE_SCOPE("Refresh border");
+            cells_.RefreshBorder();
+        }
+        RefreshHash(threads);
+
+        // Each tile only writes its own cells in nextCells_, so the result doesn't depend on the thread count
+        size_t reach = (cells_.Border() + TileSize - 1) / TileSize;
+        const std::vector<size_t>& tiles = activeTiles_.Schedule(reach);
+        std::atomic<uint64_t> hashChange = 0;
+        threads.ParallelFor(tiles.size(), [&](size_t index)
+        {
+            PROFILE_SCOPE("Step tile");
+            size_t tileIndex = tiles[index];
+            size_t firstX = (tileIndex % tileColumns) * TileSize;
+            size_t firstY = (tileIndex / tileColumns) * TileSize;
+            Tile tile{ firstX, std::min(firstX + TileSize, width), firstY, std::min(firstY + TileSize, height) };
+            stepTile_(cells_, nextCells_, tile);
+            uint64_t tileHashChange = 0;
+            if (Stencil::Differs(cells_, nextCells_, tile, tileHashChange)) {
+                activeTiles_.SetChanged(tileIndex);
+                hashChange.fetch_xor(tileHashChange, std::memory_order_relaxed);
+            }
+        });
+        activeTiles_.Finish();
+        cells_.Swap(nextCells_);
+        hash_ ^= hashChange.load();
+    }
+
+    /**
+     * The most generations StepBlock() steps at once, chosen from the
+     * stepper's radius along with how many tiles across a block is. Blocks
+     * are as large as keeps them and their halo in cache, and as many
+     * generations as keep recomputing the shrinking halo to at most a quarter
+     * again as many cells as the block itself are stepped, e.g. 8 generations
+     * of 256 x 256 cells for the Moore neighbourhood on uint8_t cells.
+     */
+    unsigned BlockGenerations() const { return blockGenerations_; }
+
+    /**
+     * Steps generations on at once, up to BlockGenerations(), with exactly
+     * the same result as calling Step() that many times.
+     *
+     * Each block of tiles is copied, along with a halo of generations *
+     * radius cells around it, into scratch buffers small enough to stay in
+     * cache. There it is stepped generation after generation, each one right
+     * for radius fewer cells in from the edge than the last, until only the
+     * block itself is left to write back. The grid is read and written once
+     * per call, rather than once per generation.
+     *
+     * BlockHashes() has the Hash() after each of the generations in turn.
+     */
+    void StepBlock(unsigned generations, ThreadPool& threads)
+    {
+        assert(generations >= 1 && generations <= blockGenerations_);
+        size_t width = cells_.Width();
+        size_t height = cells_.Height();
+        size_t tileColumns = ResizeTiles();
+        size_t blockColumns = (tileColumns + blockTiles_ - 1) / blockTiles_;
+        RefreshHash(threads);
+
+        // Tiles that changed in any generation of the last block are flagged, so a skipped tile is the same in both buffers
+        size_t halo = generations * cells_.Border();
+        size_t reach = (halo + TileSize - 1) / TileSize;
+        blocks_.clear();
+        for (size_t tile : activeTiles_.Schedule(reach)) {
+            blocks_.push_back(((tile / tileColumns / blockTiles_) * blockColumns) + ((tile % tileColumns) / blockTiles_));
+        }
+        std::sort(blocks_.begin(), blocks_.end());
+        blocks_.erase(std::unique(blocks_.begin(), blocks_.end()), blocks_.end());
+
+        std::array<std::atomic<uint64_t>, MaxBlockGenerations> hashChanges{};
+        size_t blockSize = blockTiles_ * TileSize;
+        threads.ParallelFor(blocks_.size(), [&](size_t index)
+        {
+            PROFILE_SCOPE("Step tile block");
+            size_t firstX = (blocks_[index] % blockColumns) * blockSize;
+            size_t firstY = (blocks_[index] / blockColumns) * blockSize;
+            Tile block{ firstX, std::min(firstX + blockSize, width), firstY, std::min(firstY + blockSize, height) };
+            std::array<uint64_t, MaxBlockGenerations> blockHashChanges{};
+            uint32_t changedTiles = StepTileBlock(block, generations, blockHashChanges);
+            for (size_t tile = 0; tile < blockTiles_ * blockTiles_; ++tile) {
+                if ((changedTiles >> tile) & 1) {
+                    activeTiles_.SetChanged((((firstY / TileSize) + (tile / blockTiles_)) * tileColumns) + (firstX / TileSize) + (tile % blockTiles_));
+                }
+            }
+            if (changedTiles != 0) {
+                for (unsigned generation = 0; generation < generations; ++generation) {
+                    hashChanges[generation].fetch_xor(blockHashChanges[generation], std::memory_order_relaxed);
+                }
+            }
+        });
+        activeTiles_.Finish();
+        cells_.Swap(nextCells_);
+
+        blockHashes_.clear();
+        for (unsigned generation = 0; generation < generations; ++generation) {
+            hash_ ^= hashChanges[generation].load();
+            blockHashes_.push_back(hash_);
+        }
+    }
+    const std::vector<uint64_t>& BlockHashes() const { return blockHashes_; }
+
+    /**
+     * See CellHash, only up to date once stepped since the cells were last
+     * written to from outside.
+     */
+    uint64_t Hash() const { return hash_; }
+
+    size_t TilesProcessed() const { return activeTiles_.ProcessedCount(); }
+    size_t TileCount() const { return activeTiles_.Count(); }
+    /**
+     * Calls visitor with the cells of each tile that changed in the last
+     * Step() or StepBlock(), see ActiveTiles::Changed.
+     */
+    template <typename Visitor>
+    void ForEachChangedTile(Visitor&& visitor) const
+    {
+        size_t columns = activeTiles_.Columns();
+        for (size_t tile = 0; tile < activeTiles_.Count(); ++tile) {
+            if (activeTiles_.Changed(tile)) {
+                size_t firstX = (tile % columns) * TileSize;
+                size_t firstY = (tile / columns) * TileSize;
+                visitor(Tile{ firstX, std::min(firstX + TileSize, Width()), firstY, std::min(firstY + TileSize, Height()) });
+            }
+        }
+    }
+
+    double Get(size_t x, size_t y) const { return static_cast<double>(cells_.Row(y)[x]); }
+
+    /**
+     * Every cell is set to zero.
+     */
+    void Resize(size_t width, size_t height)
+    {
+        cells_ = Grid<CellType>(width, height, cells_.Border());
+        nextCells_ = Grid<CellType>(width, height, nextCells_.Border());
+        activeTiles_.MarkAllChanged();
+        hashStale_ = true;
+    }
+
+    /**
+     * Resizes to match cells.
+     */
+    void Import(const Grid<double>& cells)
+    {
+        cells_.Resize(cells.Width(), cells.Height());
+        nextCells_.Resize(cells.Width(), cells.Height());
+        for (size_t y = 0; y < cells.Height(); ++y) {
+            ImportRow(y, cells.Row(y));
+        }
+        activeTiles_.MarkAllChanged();
+        hashStale_ = true;
+    }
+    /**
+     * cells must have the same dimensions.
+     */
+    void Export(Grid<double>& cells) const
+    {
+        assert(cells.Width() == Width() && cells.Height() == Height());
+        for (size_t y = 0; y < Height(); ++y) {
+            ExportRow(y, cells.Row(y));
+        }
+    }
+
+    /**
+     * Width() values at a time. Importing a row doesn't mark anything as
+     * changed, it is for filling in the cells after Resize() or Import().
+     */
+    void ImportRow(size_t y, const double* values)
+    {
+        std::transform(values, values + Width(), cells_.Row(y), FromDouble);
+        hashStale_ = true;
+    }
+    void ExportRow(size_t y, double* values) const
+    {
+        std::copy_n(cells_.Row(y), Width(), values);
+    }
+    /**
+     * Row y as stored, RowBytes() bytes of CellType, for copying cells in and
+     * out without conversion. Writing doesn't mark anything as changed, as
+     * ImportRow.
+     */
+    size_t RowBytes() const { return Width() * sizeof(CellType); }
+    const void* RowData(size_t y) const { return cells_.Row(y); }
+    void* RowData(size_t y) { hashStale_ = true; return cells_.Row(y); }
+
+    /**
+     * Each cell's value depends only on the seed and its position, and is
+     * converted to CellType as Import would.
+     */
+    template <typename T>
+    void Randomise(T min, T max, uint64_t seed, ThreadPool& threads)
+    {
+        size_t width = cells_.Width();
+        threads.ParallelFor(cells_.Height(), [&](size_t y)
+        {
+            CellType* row = cells_.Row(y);
+            for (size_t x = 0; x < width; ++x) {
+                row[x] = FromDouble(static_cast<double>(Philox::Number(seed, (y * width) + x, min, max)));
+            }
+        });
+        activeTiles_.MarkAllChanged();
+        hashStale_ = true;
+    }
+
+    static CellType FromDouble(double value)
+    {
+        if constexpr (std::is_integral<CellType>::value) {
+            double lowest = static_cast<double>(std::numeric_limits<CellType>::lowest());
+            double highest = static_cast<double>(std::numeric_limits<CellType>::max());
+            return static_cast<CellType>(std::clamp(std::round(value), lowest, highest));
+        } else {
+            return static_cast<CellType>(value);
+        }
+    }
+
+private:
+    static constexpr size_t TileSize = 64;
+    static constexpr unsigned MaxBlockGenerations = 8;
+    // Up to 4 x 4 tiles, so that a block's changed tiles fit in a uint32_t
+    static constexpr size_t MaxBlockTiles = 4;
+    // A typical L2 cache, which a block's two scratch buffers must fit in
+    static constexpr size_t CacheBytes = 256 * 1024;
+
+    Grid<CellType> cells_;
+    Grid<CellType> nextCells_;
+    ActiveTiles activeTiles_;
+    TileStepper stepTile_;
+    uint64_t hash_ = 0;
+    bool hashStale_ = true;
+    unsigned blockGenerations_ = 1;
+    // Tiles across each side of a block
+    size_t blockTiles_ = 1;
+    std::vector<size_t> blocks_;
+    std::vector<uint64_t> blockHashes_;
+
+    void ChooseBlocks(size_t radius)
+    {
+        blockGenerations_ = 1;
+        blockTiles_ = 1;
+        for (size_t blockTiles = MaxBlockTiles; blockTiles >= 1; blockTiles /= 2) {
+            size_t blockSize = blockTiles * TileSize;
+            unsigned generations = 0;
+            // Cells stepped over the generations, the block plus what is left of the halo each generation
+            size_t stepped = 0;
+            while (generations < MaxBlockGenerations) {
+                size_t scratchSide = blockSize + (2 * (generations + 1) * radius);
+                size_t haloSide = blockSize + (2 * generations * radius);
+                size_t nextStepped = stepped + (haloSide * haloSide);
+                if (2 * scratchSide * scratchSide * sizeof(CellType) > CacheBytes || 4 * nextStepped > 5 * (generations + 1) * blockSize * blockSize) {
+                    break;
+                }
+                ++generations;
+                stepped = nextStepped;
+            }
+            // Larger blocks come first, and waste less on their halo
+            if (generations > blockGenerations_) {
+                blockGenerations_ = generations;
+                blockTiles_ = blockTiles;
+            }
+        }
+    }
+
+    /**
+     * Returns the number of columns of tiles.
+     */
+    size_t ResizeTiles()
+    {
+        size_t tileColumns = (cells_.Width() + TileSize - 1) / TileSize;
+        size_t tileRows = (cells_.Height() + TileSize - 1) / TileSize;
+        if (activeTiles_.Columns() != tileColumns || activeTiles_.Rows() != tileRows) {
+            activeTiles_.Resize(tileColumns, tileRows);
+        }
+        return tileColumns;
+    }
+
+    /**
+     * Steps block generations on from cells_ and writes the result into
+     * nextCells_. Returns which of its tiles changed in any generation, a bit
+     * each from the top left, row by row, each generation's change to the
+     * hash being XORed into hashChanges.
+     */
+    uint32_t StepTileBlock(const Tile& block, unsigned generations, std::array<uint64_t, MaxBlockGenerations>& hashChanges)
+    {
+        size_t width = cells_.Width();
+        size_t height = cells_.Height();
+        size_t radius = cells_.Border();
+        size_t halo = generations * radius;
+        size_t blockWidth = block.lastX - block.firstX;
+        size_t blockHeight = block.lastY - block.firstY;
+        size_t scratchWidth = blockWidth + (2 * halo);
+        size_t scratchHeight = blockHeight + (2 * halo);
+
+        // Sized for a whole block, so that the smaller ones at the edges don't reallocate
+        thread_local Grid<CellType> scratch;
+        thread_local Grid<CellType> nextScratch;
+        size_t scratchSide = (blockTiles_ * TileSize) + (2 * halo);
+        scratch.Resize(scratchSide, scratchSide);
+        nextScratch.Resize(scratchSide, scratchSide);
+
+        // The halo wraps around the torus, as many times as it takes if it is wider than the grid
+        size_t sourceFirstX = (block.firstX + width - (halo % width)) % width;
+        size_t sourceFirstY = (block.firstY + height - (halo % height)) % height;
+        for (size_t y = 0; y < scratchHeight; ++y) {
+            const CellType* row = cells_.Row((sourceFirstY + y) % height);
+            CellType* scratchRow = scratch.Row(y);
+            for (size_t x = 0, sourceX = sourceFirstX; x < scratchWidth; sourceX = 0) {
+                size_t count = std::min(scratchWidth - x, width - sourceX);
+                std::copy_n(row + sourceX, count, scratchRow + x);
+                x += count;
+            }
+        }
+
+        uint32_t changedTiles = 0;
+        for (unsigned generation = 0; generation < generations; ++generation) {
+            size_t inset = (generation + 1) * radius;
+            stepTile_(scratch, nextScratch, Tile{ inset, scratchWidth - inset, inset, scratchHeight - inset });
+            for (size_t y = 0; y < blockHeight; ++y) {
+                const CellType* row = scratch.Row(halo + y) + halo;
+                const CellType* nextRow = nextScratch.Row(halo + y) + halo;
+                uint64_t position = ((block.firstY + y) * width) + block.firstX;
+                for (size_t x = 0; x < blockWidth; x += TileSize) {
+                    if (Stencil::RowDiffers(row + x, nextRow + x, std::min(TileSize, blockWidth - x), position + x, hashChanges[generation])) {
+                        changedTiles |= uint32_t(1) << (((y / TileSize) * blockTiles_) + (x / TileSize));
+                    }
+                }
+            }
+            scratch.Swap(nextScratch);
+        }
+
+        for (size_t y = 0; y < blockHeight; ++y) {
+            std::copy_n(scratch.Row(halo + y) + halo, blockWidth, nextCells_.Row(block.firstY + y) + block.firstX);
+        }
+        return changedTiles;
+    }
+
+    void RefreshHash(ThreadPool& threads)
+    {
+        if (!hashStale_) {
+            return;
+        }
+        PROFILE_SCOPE("Refresh hash");
+        std::atomic<uint64_t> hash = 0;
+        size_t width = cells_.Width();
+        threads.ParallelFor(cells_.Height(), [&](size_t y)
+        {
+            const CellType* row = cells_.Row(y);
+            uint64_t rowHash = 0;
+            for (size_t x = 0; x < width; ++x) {
+                rowHash ^= CellHash::Of((y * width) + x, CellHash::Bits(row[x]));
+            }
+            hash.fetch_xor(rowHash, std::memory_order_relaxed);
+        });
+        hash_ = hash.load();
+        hashStale_ = false;
+    }
+};
+
+#endif // STENCILENGINE_H
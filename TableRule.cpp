@@ -0,0 +1,308 @@
+#include "TableRule.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static std::vector<std::string> Split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts(1);
+    for (char c : text) {
+        if (c == separator) {
+            parts.emplace_back();
+        } else {
+            parts.back() += c;
+        }
+    }
+    return parts;
+}
+
+static bool ParseUnsigned(const std::string& text, unsigned& value)
+{
+    if (text.empty() || text.size() > 9 || !std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+        return false;
+    }
+    value = static_cast<unsigned>(std::strtoul(text.c_str(), nullptr, 10));
+    return true;
+}
+
+/**
+ * Life-like counts, one digit per count, e.g. "23".
+ */
+static bool ParseDigits(const std::string& digits, std::vector<bool>& counts, std::string& error)
+{
+    for (char digit : digits) {
+        if (digit < '0' || digit > '8') {
+            error = std::string("'") + digit + "' isn't a neighbour count from 0 to 8";
+            return false;
+        }
+        counts[static_cast<size_t>(digit - '0')] = true;
+    }
+    return true;
+}
+
+/**
+ * Larger than Life counts, "first..last", a single count, or nothing.
+ */
+static bool ParseRange(const std::string& range, std::vector<bool>& counts, std::string& error)
+{
+    if (range.empty()) {
+        return true;
+    }
+
+    size_t dots = range.find("..");
+    unsigned first = 0;
+    unsigned last = 0;
+    if (dots == std::string::npos) {
+        if (!ParseUnsigned(range, first)) {
+            error = "'" + range + "' isn't a count or a range of counts";
+            return false;
+        }
+        last = first;
+    } else if (!ParseUnsigned(range.substr(0, dots), first) || !ParseUnsigned(range.substr(dots + 2), last) || first > last) {
+        error = "'" + range + "' isn't a range of counts";
+        return false;
+    }
+
+    if (last >= counts.size()) {
+        error = "'" + range + "' goes past the " + std::to_string(counts.size() - 1) + " cells in the neighbourhood";
+        return false;
+    }
+    std::fill(counts.begin() + first, counts.begin() + last + 1, true);
+    return true;
+}
+
+/**
+ * Dead cells with a birth count come alive, live cells with a survival count
+ * stay alive. Otherwise live cells start to decay, and decaying cells carry
+ * on through the states until they die.
+ */
+static void BuildTable(TableRule& rule, const std::vector<bool>& birth, const std::vector<bool>& survival)
+{
+    size_t countStride = rule.NeighbourCount() + 1;
+    rule.table.assign(256 * countStride, 0);
+    for (size_t count = 0; count < countStride; ++count) {
+        rule.table[count] = birth[count] ? 1 : 0;
+        rule.table[countStride + count] = survival[count] ? 1 : (rule.states > 2 ? 2 : 0);
+        for (unsigned state = 2; state < rule.states; ++state) {
+            rule.table[(state * countStride) + count] = static_cast<uint8_t>(state + 1 < rule.states ? state + 1 : 0);
+        }
+    }
+}
+
+static std::optional<TableRule> CompileLifeLike(const std::string& notation, std::string& error)
+{
+    std::vector<std::string> parts = Split(notation, '/');
+    if (parts.size() < 2 || parts.size() > 3) {
+        error = "expected B.../S... or B.../S.../states";
+        return std::nullopt;
+    }
+
+    std::string birthDigits;
+    std::string survivalDigits;
+    std::string states;
+    bool lettered = std::any_of(parts.begin(), parts.end(), [](const std::string& part) { return !part.empty() && std::isalpha(static_cast<unsigned char>(part[0])); });
+    if (lettered) {
+        bool hasBirth = false;
+        bool hasSurvival = false;
+        for (size_t index = 0; index < parts.size(); ++index) {
+            const std::string& part = parts[index];
+            char letter = part.empty() ? '\0' : part[0];
+            if (letter == 'B' && !hasBirth) {
+                birthDigits = part.substr(1);
+                hasBirth = true;
+            } else if (letter == 'S' && !hasSurvival) {
+                survivalDigits = part.substr(1);
+                hasSurvival = true;
+            } else if (letter == 'C' || letter == 'G') {
+                states = part.substr(1);
+            } else if (index == 2 && !part.empty() && std::isdigit(static_cast<unsigned char>(letter))) {
+                states = part;
+            } else {
+                error = "'" + part + "' should be B followed by birth counts, S followed by survival counts, or a number of states";
+                return std::nullopt;
+            }
+        }
+        if (!hasBirth || !hasSurvival) {
+            error = "expected both a B and an S part";
+            return std::nullopt;
+        }
+    } else {
+        // The older S/B order
+        survivalDigits = parts[0];
+        birthDigits = parts[1];
+        if (parts.size() == 3) {
+            states = parts[2];
+        }
+    }
+
+    TableRule rule;
+    if (!states.empty() && (!ParseUnsigned(states, rule.states) || rule.states < 2 || rule.states > 256)) {
+        error = "'" + states + "' isn't a number of states from 2 to 256";
+        return std::nullopt;
+    }
+
+    std::vector<bool> birth(rule.NeighbourCount() + 1, false);
+    std::vector<bool> survival(rule.NeighbourCount() + 1, false);
+    if (!ParseDigits(birthDigits, birth, error) || !ParseDigits(survivalDigits, survival, error)) {
+        return std::nullopt;
+    }
+    BuildTable(rule, birth, survival);
+    return rule;
+}
+
+static std::optional<TableRule> CompileLargerThanLife(const std::string& notation, std::string& error)
+{
+    TableRule rule;
+    std::string birthRange;
+    std::string survivalRange;
+    bool hasBirth = false;
+    bool hasSurvival = false;
+    for (const std::string& field : Split(notation, ',')) {
+        std::string value = field.empty() ? "" : field.substr(1);
+        unsigned number = 0;
+        switch (field.empty() ? '\0' : field[0]) {
+        case 'R':
+            if (!ParseUnsigned(value, rule.radius) || rule.radius < 1 || rule.radius > TableRule::MaxRadius) {
+                error = "the range R must be from 1 to " + std::to_string(TableRule::MaxRadius);
+                return std::nullopt;
+            }
+            break;
+        case 'C':
+            // C0 and C1 both mean a binary rule
+            if (!ParseUnsigned(value, number) || number > 256) {
+                error = "the number of states C must be from 0 to 256";
+                return std::nullopt;
+            }
+            rule.states = std::max(2u, number);
+            break;
+        case 'M':
+            if (value != "0" && value != "1") {
+                error = "M must be 0 or 1";
+                return std::nullopt;
+            }
+            rule.countsCentre = value == "1";
+            break;
+        case 'S':
+            survivalRange = value;
+            hasSurvival = true;
+            break;
+        case 'B':
+            birthRange = value;
+            hasBirth = true;
+            break;
+        case 'N':
+            if (value != "M" && value != "N") {
+                error = "the neighbourhood must be NM, Moore, or NN, von Neumann";
+                return std::nullopt;
+            }
+            rule.shape = value == "M" ? TableRule::Shape::Moore : TableRule::Shape::VonNeumann;
+            break;
+        default:
+            error = "'" + field + "' isn't an R, C, M, S, B or N field";
+            return std::nullopt;
+        }
+    }
+    if (!hasBirth || !hasSurvival) {
+        error = "expected both a B and an S field";
+        return std::nullopt;
+    }
+
+    std::vector<bool> birth(rule.NeighbourCount() + 1, false);
+    std::vector<bool> survival(rule.NeighbourCount() + 1, false);
+    if (!ParseRange(birthRange, birth, error) || !ParseRange(survivalRange, survival, error)) {
+        return std::nullopt;
+    }
+    BuildTable(rule, birth, survival);
+    return rule;
+}
+
+std::optional<TableRule> TableRule::Compile(const std::string& notation, std::string& error)
+{
+    std::string text;
+    for (char c : notation) {
+        if (!std::isspace(static_cast<unsigned char>(c))) {
+            text += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+    }
+
+    if (text.empty()) {
+        error = "the rule is empty";
+        return std::nullopt;
+    } else if (text.size() > 1 && text[0] == 'R' && std::isdigit(static_cast<unsigned char>(text[1]))) {
+        return CompileLargerThanLife(text, error);
+    }
+    return CompileLifeLike(text, error);
+}
+
+unsigned TableRule::NeighbourCount() const
+{
+    unsigned cells = shape == Shape::Moore ? ((2 * radius) + 1) * ((2 * radius) + 1) : (2 * radius * (radius + 1)) + 1;
+    return countsCentre ? cells : cells - 1;
+}
+
+std::optional<LifeRule> TableRule::AsLifeRule() const
+{
+    if (states != 2 || radius != 1 || shape != Shape::Moore || countsCentre) {
+        return std::nullopt;
+    }
+
+    LifeRule rule{ 0, 0 };
+    for (unsigned count = 0; count <= 8; ++count) {
+        rule.birth |= static_cast<uint16_t>(NextState(0, count) << count);
+        rule.survival |= static_cast<uint16_t>(NextState(1, count) << count);
+    }
+    return rule;
+}
+
+void TableRule::StepTile(const Grid<CellType>& cells, Grid<CellType>& nextCells, const Tile& tile) const
+{
+    // Prefix sums cover the tile plus the rule's reach, with one extra column for the end of the last run
+    ptrdiff_t reach = static_cast<ptrdiff_t>(radius);
+    ptrdiff_t firstX = static_cast<ptrdiff_t>(tile.firstX) - reach;
+    ptrdiff_t firstY = static_cast<ptrdiff_t>(tile.firstY) - reach;
+    ptrdiff_t prefixStride = static_cast<ptrdiff_t>(tile.lastX - tile.firstX) + (2 * reach) + 1;
+    ptrdiff_t prefixRows = static_cast<ptrdiff_t>(tile.lastY - tile.firstY) + (2 * reach);
+
+    thread_local std::vector<uint16_t> prefixSums;
+    prefixSums.resize(prefixStride * prefixRows);
+    for (ptrdiff_t row = 0; row < prefixRows; ++row) {
+        const CellType* cellRow = cells.Row(firstY + row) + firstX;
+        uint16_t* prefixRow = prefixSums.data() + (row * prefixStride);
+        uint16_t total = 0;
+        prefixRow[0] = total;
+        for (ptrdiff_t column = 1; column < prefixStride; ++column) {
+            total += cellRow[column - 1] == 1 ? 1 : 0;
+            prefixRow[column] = total;
+        }
+    }
+
+    // How far each row of the neighbourhood, top to bottom, reaches either side of the centre
+    ptrdiff_t halfWidths[(2 * MaxRadius) + 1];
+    for (ptrdiff_t yOffset = -reach; yOffset <= reach; ++yOffset) {
+        halfWidths[yOffset + reach] = shape == Shape::Moore ? reach : reach - std::abs(yOffset);
+    }
+
+    size_t countStride = NeighbourCount() + 1;
+    for (size_t y = tile.firstY; y < tile.lastY; ++y) {
+        const CellType* row = cells.Row(y);
+        CellType* nextRow = nextCells.Row(y);
+        // The top row of the neighbourhood, offset so that it can be indexed by x
+        const uint16_t* topRow = prefixSums.data() + ((static_cast<ptrdiff_t>(y) - reach - firstY) * prefixStride) - firstX;
+        for (size_t x = tile.firstX; x < tile.lastX; ++x) {
+            ptrdiff_t centre = static_cast<ptrdiff_t>(x);
+            unsigned live = 0;
+            const uint16_t* prefixRow = topRow;
+            for (ptrdiff_t row = 0; row <= 2 * reach; ++row) {
+                live += prefixRow[centre + halfWidths[row] + 1] - prefixRow[centre - halfWidths[row]];
+                prefixRow += prefixStride;
+            }
+
+            CellType state = row[x];
+            if (!countsCentre && state == 1) {
+                --live;
+            }
+            nextRow[x] = table[(state * countStride) + live];
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef TABLERULE_H
+#define TABLERULE_H
+
+#include "LifeRule.h"
+#include "Grid.h"
+#include "Stencil.h"
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <stdint.h>
+
+/**
+ * A rule compiled from standard rule notation into a table of next states,
+ * indexed by a cell's state and how many of its neighbours are alive. Stepping
+ * a cell is then a count and a lookup, however complicated the rule.
+ *
+ * Understands:
+ *  - Life-like rules, "B3/S23", "B36/S23", or the older S/B form "23/3"
+ *  - Generations rules, "B2/S/3", where live cells that don't survive decay
+ *    through the extra states before dying, and only state 1 counts as alive
+ *  - Larger than Life rules, "R5,C0,M1,S34..58,B34..45,NM", with a range R
+ *    Moore (NM) or von Neumann (NN) neighbourhood, C states as in
+ *    Generations, and M1 to count the cell itself as a neighbour
+ *
+ * Cells are uint8_t states, anything from the rule's state count upwards dies.
+ */
+struct TableRule {
+    enum class Shape {
+        Moore,
+        VonNeumann,
+    };
+
+    // The neighbourhood reaches this far in each direction, Larger than Life rules allow up to MaxRadius
+    static constexpr unsigned MaxRadius = 16;
+
+    using CellType = uint8_t;
+
+    unsigned radius = 1;
+    Shape shape = Shape::Moore;
+    bool countsCentre = false;
+    // 2 for binary rules
+    unsigned states = 2;
+    // Indexed by (state * (NeighbourCount() + 1)) + live neighbours, a row for every possible uint8_t state
+    std::vector<uint8_t> table;
+
+    /**
+     * Empty, and error says why, if the notation isn't understood.
+     */
+    static std::optional<TableRule> Compile(const std::string& notation, std::string& error);
+
+    /**
+     * The most live neighbours a cell can have.
+     */
+    unsigned NeighbourCount() const;
+
+    uint8_t NextState(uint8_t state, unsigned liveNeighbours) const { return table[(state * (NeighbourCount() + 1)) + liveNeighbours]; }
+
+    /**
+     * The same rule as a LifeRule, for LifeEngine, if it is a binary rule on
+     * the eight cell Moore neighbourhood.
+     */
+    std::optional<LifeRule> AsLifeRule() const;
+
+    /**
+     * Counts neighbours from prefix sums of each row's live cells, so a row of
+     * the neighbourhood of any width costs a single subtraction.
+     */
+    void StepTile(const Grid<CellType>& cells, Grid<CellType>& nextCells, const Tile& tile) const;
+};
+
+#endif // TABLERULE_H
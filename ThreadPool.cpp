@@ -1 +1,169 @@
 #include "ThreadPool.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : queued_(0)
+    , stopping_(false)
+{
+    Start(threadCount);
+}
+
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+void ThreadPool::SetThreadCount(unsigned threadCount)
+{
+    Stop();
+    Start(threadCount);
+}
+
+void ThreadPool::ParallelFor(size_t taskCount, const std::function<void (size_t)>& task)
+{
+    if (taskCount == 0) {
+        return;
+    }
+
+    if (workers_.empty() || taskCount == 1) {
+#ifdef CA_PROFILE
+        uint64_t start = Profiler::Now();
+#endif
+        for (size_t index = 0; index < taskCount; ++index) {
+            task(index);
+        }
+#ifdef CA_PROFILE
+        queues_[0]->tasksRun += taskCount;
+        queues_[0]->busyNanoseconds += Profiler::Now() - start;
+#endif
+        return;
+    }
+
+    Batch batch{ &task, { taskCount } };
+
+    // Deal out contiguous blocks, the caller's block is at the front of queue 0
+    size_t queueCount = queues_.size();
+    for (size_t queueIndex = 0; queueIndex < queueCount; ++queueIndex) {
+        size_t begin = (taskCount * queueIndex) / queueCount;
+        size_t end = (taskCount * (queueIndex + 1)) / queueCount;
+        if (begin == end) {
+            continue;
+        }
+        Queue& queue = *queues_[queueIndex];
+        std::lock_guard lock(queue.mutex);
+        // Pushed in reverse so the owner, popping from the back, walks the block in order
+        for (size_t index = end; index > begin; --index) {
+            queue.tasks.push_back({ &batch, index - 1 });
+        }
+    }
+    queued_ += taskCount;
+    {
+        std::lock_guard lock(sleepMutex_);
+        workAvailable_.notify_all();
+    }
+
+    while (batch.remaining.load() > 0) {
+        if (!TryRunTask(0)) {
+            std::unique_lock lock(sleepMutex_);
+            batchFinished_.wait(lock, [&]() { return batch.remaining.load() == 0 || queued_.load() > 0; });
+        }
+    }
+}
+
+std::vector<ThreadPool::ThreadStats> ThreadPool::Stats() const
+{
+    std::vector<ThreadStats> stats;
+#ifdef CA_PROFILE
+    for (const auto& queue : queues_) {
+        stats.push_back({ queue->tasksRun.load(), queue->tasksStolen.load(), queue->busyNanoseconds.load() });
+    }
+#endif
+    return stats;
+}
+
+void ThreadPool::Start(unsigned threadCount)
+{
+    threadCount = std::max(1u, threadCount);
+    stopping_ = false;
+    queues_.clear();
+    for (unsigned i = 0; i < threadCount; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 1; i < threadCount; ++i) {
+        workers_.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+void ThreadPool::Stop()
+{
+    {
+        std::lock_guard lock(sleepMutex_);
+        stopping_ = true;
+        workAvailable_.notify_all();
+    }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+void ThreadPool::WorkerLoop(size_t queueIndex)
+{
+    while (true) {
+        if (TryRunTask(queueIndex)) {
+            continue;
+        }
+        std::unique_lock lock(sleepMutex_);
+        workAvailable_.wait(lock, [&]() { return stopping_ || queued_.load() > 0; });
+        if (stopping_ && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryRunTask(size_t queueIndex)
+{
+    Task task{ nullptr, 0 };
+    [[maybe_unused]] bool stolen = false;
+    Queue& own = *queues_[queueIndex];
+    {
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+        }
+    }
+    for (size_t offset = 1; task.batch == nullptr && offset < queues_.size(); ++offset) {
+        Queue& victim = *queues_[(queueIndex + offset) % queues_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            stolen = true;
+        }
+    }
+    if (task.batch == nullptr) {
+        return false;
+    }
+    --queued_;
+
+#ifdef CA_PROFILE
+    uint64_t start = Profiler::Now();
+#endif
+    (*task.batch->task)(task.index);
+#ifdef CA_PROFILE
+    ++own.tasksRun;
+    own.tasksStolen += stolen ? 1 : 0;
+    own.busyNanoseconds += Profiler::Now() - start;
+#endif
+
+    // The batch lives on the caller's stack, don't touch it once the count hits zero
+    if (--task.batch->remaining == 0) {
+        std::lock_guard lock(sleepMutex_);
+        batchFinished_.notify_all();
+    }
+    return true;
+}
@@ -1,9 +1,93 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+/**
+ * A fixed set of persistent worker threads, each owning a deque of tasks.
+ * Workers pop from the back of their own deque and steal from the front of
+ * the others' once theirs runs dry. The thread calling ParallelFor works too,
+ * so a pool of N threads only spawns N - 1 workers, and a pool of one thread
+ * runs everything serially on the caller.
+ */
 class ThreadPool {
 public:
-    // TODO
+    explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    unsigned ThreadCount() const { return static_cast<unsigned>(queues_.size()); }
+    /**
+     * Joins the current workers and starts new ones, must not be called while
+     * a ParallelFor is in progress.
+     */
+    void SetThreadCount(unsigned threadCount);
+
+    /**
+     * Calls task(index) for every index in [0, taskCount) across all threads
+     * and blocks until every call has returned. Tasks are handed out in
+     * contiguous blocks so neighbouring indices tend to run on the same thread.
+     * Several threads may call this at once, their tasks share the workers.
+     */
+    void ParallelFor(size_t taskCount, const std::function<void(size_t index)>& task);
+
+    struct ThreadStats {
+        uint64_t tasksRun;
+        // Of tasksRun, those taken from another thread's queue
+        uint64_t tasksStolen;
+        uint64_t busyNanoseconds;
+    };
+    /**
+     * Per thread since the last SetThreadCount, the caller's first. Only
+     * counted when profiling, see Profiler, empty otherwise.
+     */
+    std::vector<ThreadStats> Stats() const;
+
+private:
+    struct Batch {
+        const std::function<void(size_t index)>* task;
+        std::atomic<size_t> remaining;
+    };
+
+    struct Task {
+        Batch* batch;
+        size_t index;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+#ifdef CA_PROFILE
+        std::atomic<uint64_t> tasksRun{ 0 };
+        std::atomic<uint64_t> tasksStolen{ 0 };
+        std::atomic<uint64_t> busyNanoseconds{ 0 };
+#endif
+    };
+
+    // Queue 0 belongs to whichever thread is calling ParallelFor
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<size_t> queued_;
+    std::mutex sleepMutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable batchFinished_;
+    bool stopping_;
+
+    void Start(unsigned threadCount);
+    void Stop();
+    void WorkerLoop(size_t queueIndex);
+    bool TryRunTask(size_t queueIndex);
 };
 
 #endif // THREADPOOL_H
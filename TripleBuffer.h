@@ -0,0 +1,55 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+
+/**
+ * Hands values from one writing thread to one reading thread without either
+ * ever waiting on the other. The writer fills Back() and publishes it, the
+ * reader takes whichever value was published most recently, any published
+ * in between are dropped.
+ *
+ * Three buffers are swapped by index: the writer owns the back, the reader
+ * owns the front, and the middle holds the latest published value until one
+ * of them exchanges theirs for it.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    /**
+     * Writer only.
+     */
+    T& Back() { return buffers_[back_]; }
+    void Publish()
+    {
+        back_ = middle_.exchange(back_ | UnreadBit, std::memory_order_acq_rel) & IndexMask;
+    }
+    /**
+     * True until the reader has taken the last value published.
+     */
+    bool Unread() const { return middle_.load(std::memory_order_relaxed) & UnreadBit; }
+
+    /**
+     * Reader only. Swaps in the latest published value if there is a new one
+     * and returns it, the value stays valid until the next call.
+     */
+    const T& Acquire()
+    {
+        if (middle_.load(std::memory_order_relaxed) & UnreadBit) {
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & IndexMask;
+        }
+        return buffers_[front_];
+    }
+
+private:
+    static constexpr unsigned IndexMask = 0b011;
+    static constexpr unsigned UnreadBit = 0b100;
+
+    std::array<T, 3> buffers_;
+    unsigned back_ = 0;
+    std::atomic<unsigned> middle_ = 1;
+    unsigned front_ = 2;
+};
+
+#endif // TRIPLEBUFFER_H